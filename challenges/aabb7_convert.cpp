@@ -0,0 +1,511 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <immintrin.h>
+
+struct Clock
+{
+  const clock_t m_start;
+  Clock() : m_start(clock())
+  {
+  }
+  float seconds() const
+  {
+    const clock_t end = clock();
+    const float seconds = ((float)(end - m_start)) / CLOCKS_PER_SEC;
+    return seconds;
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+float3 min(const float3 a, const float3 b)
+{
+  float3 c = {std::min(a.x,b.x), std::min(a.y,b.y), std::min(a.z,b.z)};
+  return c;
+}
+
+float3 max(const float3 a, const float3 b)
+{
+  float3 c = {std::max(a.x,b.x), std::max(a.y,b.y), std::max(a.z,b.z)};
+  return c;
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABB(float3* mini, float3* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyz;
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      *mini = min(*mini, xyz);
+      *maxi = max(*maxi, xyz);
+    }
+  }
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+// AABBs as separate columns of each coordinate, the way a SIMD pipeline tends to produce them.
+struct AABBColumns
+{
+  float* m_minX;
+  float* m_minY;
+  float* m_minZ;
+  float* m_maxX;
+  float* m_maxY;
+  float* m_maxZ;
+};
+
+// The 7-sided AABB of aabo.cpp: the AABB, plus the corner-cutting plane x+y+z, stored negated
+// in the d lane of each side so that both sides are tested with the same <= as an AABO.
+void SevenScalar(const float3 aabbMin, const float3 aabbMax, float4* sevenMin, float4* sevenMax)
+{
+  sevenMin->a = aabbMin.x;
+  sevenMin->b = aabbMin.y;
+  sevenMin->c = aabbMin.z;
+  sevenMin->d = -(aabbMax.x + aabbMax.y + aabbMax.z);
+  sevenMax->a = aabbMax.x;
+  sevenMax->b = aabbMax.y;
+  sevenMax->c = aabbMax.z;
+  sevenMax->d = -(aabbMin.x + aabbMin.y + aabbMin.z);
+}
+
+// Streaming stores send the output straight to memory instead of through the cache, which
+// is what you want when the converted columns won't be read again until the next frame.
+template<bool kStream> void Store(float4* out, const __m128 v)
+{
+  if(kStream)
+    _mm_stream_ps((float*)out, v);
+  else
+    _mm_store_ps((float*)out, v);
+}
+
+// Four objects' x,y,z, as rows of their coordinates, turned into four 7-sided pairs.
+// The sums are added in the same order as SevenScalar's, so the results match it bit for bit.
+template<bool kStream> void StoreSeven(__m128 minX, __m128 minY, __m128 minZ, __m128 maxX, __m128 maxY, __m128 maxZ, float4* sevenMin, float4* sevenMax)
+{
+  const __m128 zero = _mm_setzero_ps();
+  __m128 minD = _mm_sub_ps(zero, _mm_add_ps(_mm_add_ps(maxX, maxY), maxZ));
+  __m128 maxD = _mm_sub_ps(zero, _mm_add_ps(_mm_add_ps(minX, minY), minZ));
+  _MM_TRANSPOSE4_PS(minX, minY, minZ, minD);
+  _MM_TRANSPOSE4_PS(maxX, maxY, maxZ, maxD);
+  Store<kStream>(sevenMin + 0, minX);
+  Store<kStream>(sevenMin + 1, minY);
+  Store<kStream>(sevenMin + 2, minZ);
+  Store<kStream>(sevenMin + 3, minD);
+  Store<kStream>(sevenMax + 0, maxX);
+  Store<kStream>(sevenMax + 1, maxY);
+  Store<kStream>(sevenMax + 2, maxZ);
+  Store<kStream>(sevenMax + 3, maxD);
+}
+
+// Four packed float3s are twelve floats, loaded as three registers and blended and shuffled
+// into rows of x, y and z. Nothing past the fourth float3 is read.
+void LoadFloat3x4(const float3* in, __m128* x, __m128* y, __m128* z)
+{
+  const __m128 r0 = _mm_loadu_ps((const float*)in + 0); // x0 y0 z0 x1
+  const __m128 r1 = _mm_loadu_ps((const float*)in + 4); // y1 z1 x2 y2
+  const __m128 r2 = _mm_loadu_ps((const float*)in + 8); // z2 x3 y3 z3
+  const __m128 tx = _mm_blend_ps(_mm_blend_ps(r0, r1, 0x4), r2, 0x2); // x0 x3 x2 x1
+  const __m128 ty = _mm_blend_ps(_mm_blend_ps(r0, r1, 0x9), r2, 0x4); // y1 y0 y3 y2
+  const __m128 tz = _mm_blend_ps(_mm_blend_ps(r0, r1, 0x2), r2, 0x9); // z2 z1 z0 z3
+  *x = _mm_shuffle_ps(tx, tx, _MM_SHUFFLE(1,2,3,0));
+  *y = _mm_shuffle_ps(ty, ty, _MM_SHUFFLE(2,3,0,1));
+  *z = _mm_shuffle_ps(tz, tz, _MM_SHUFFLE(3,0,1,2));
+}
+
+// From AABB min and max columns of float3, as aabo.cpp keeps them. Converts [first, end),
+// so a pipeline can hand over each batch of bounds as soon as it has produced it.
+template<bool kStream> void SevenFromAoS(const float3* aabbMin, const float3* aabbMax, int first, int end, float4* sevenMin, float4* sevenMax)
+{
+  int o = first;
+  for(; o + 4 <= end; o += 4)
+  {
+    __m128 minX, minY, minZ, maxX, maxY, maxZ;
+    LoadFloat3x4(aabbMin + o, &minX, &minY, &minZ);
+    LoadFloat3x4(aabbMax + o, &maxX, &maxY, &maxZ);
+    StoreSeven<kStream>(minX, minY, minZ, maxX, maxY, maxZ, sevenMin + o, sevenMax + o);
+  }
+  for(; o < end; ++o)
+    SevenScalar(aabbMin[o], aabbMax[o], &sevenMin[o], &sevenMax[o]);
+}
+
+// From AABBs in coordinate columns, which need no shuffling on the way in. With AVX, eight
+// objects are converted at a time, and the 8x4 transpose is done within each 128-bit half.
+template<bool kStream> void SevenFromSoA(const AABBColumns& aabb, int first, int end, float4* sevenMin, float4* sevenMax)
+{
+  int o = first;
+#ifdef __AVX__
+  const __m256 zero = _mm256_setzero_ps();
+  for(; o + 8 <= end; o += 8)
+  {
+    const __m256 minX = _mm256_loadu_ps(aabb.m_minX + o);
+    const __m256 minY = _mm256_loadu_ps(aabb.m_minY + o);
+    const __m256 minZ = _mm256_loadu_ps(aabb.m_minZ + o);
+    const __m256 maxX = _mm256_loadu_ps(aabb.m_maxX + o);
+    const __m256 maxY = _mm256_loadu_ps(aabb.m_maxY + o);
+    const __m256 maxZ = _mm256_loadu_ps(aabb.m_maxZ + o);
+    const __m256 minD = _mm256_sub_ps(zero, _mm256_add_ps(_mm256_add_ps(maxX, maxY), maxZ));
+    const __m256 maxD = _mm256_sub_ps(zero, _mm256_add_ps(_mm256_add_ps(minX, minY), minZ));
+    const __m256 row[2][4] = {{minX, minY, minZ, minD}, {maxX, maxY, maxZ, maxD}};
+    float4* const out[2] = {sevenMin + o, sevenMax + o};
+    for(int side = 0; side < 2; ++side)
+    {
+      const __m256 xy0 = _mm256_unpacklo_ps(row[side][0], row[side][1]); // x0 y0 x1 y1 | x4 y4 x5 y5
+      const __m256 xy1 = _mm256_unpackhi_ps(row[side][0], row[side][1]); // x2 y2 x3 y3 | x6 y6 x7 y7
+      const __m256 zd0 = _mm256_unpacklo_ps(row[side][2], row[side][3]);
+      const __m256 zd1 = _mm256_unpackhi_ps(row[side][2], row[side][3]);
+      const __m256 object[4] =
+      {
+        _mm256_shuffle_ps(xy0, zd0, _MM_SHUFFLE(1,0,1,0)), // objects 0 | 4
+        _mm256_shuffle_ps(xy0, zd0, _MM_SHUFFLE(3,2,3,2)), // objects 1 | 5
+        _mm256_shuffle_ps(xy1, zd1, _MM_SHUFFLE(1,0,1,0)), // objects 2 | 6
+        _mm256_shuffle_ps(xy1, zd1, _MM_SHUFFLE(3,2,3,2)), // objects 3 | 7
+      };
+      for(int i = 0; i < 4; ++i)
+      {
+        Store<kStream>(out[side] + i, _mm256_castps256_ps128(object[i]));
+        Store<kStream>(out[side] + i + 4, _mm256_extractf128_ps(object[i], 1));
+      }
+    }
+  }
+#endif
+  for(; o + 4 <= end; o += 4)
+    StoreSeven<kStream>(_mm_loadu_ps(aabb.m_minX + o), _mm_loadu_ps(aabb.m_minY + o), _mm_loadu_ps(aabb.m_minZ + o),
+                        _mm_loadu_ps(aabb.m_maxX + o), _mm_loadu_ps(aabb.m_maxY + o), _mm_loadu_ps(aabb.m_maxZ + o),
+                        sevenMin + o, sevenMax + o);
+  for(; o < end; ++o)
+  {
+    const float3 mini = {aabb.m_minX[o], aabb.m_minY[o], aabb.m_minZ[o]};
+    const float3 maxi = {aabb.m_maxX[o], aabb.m_maxY[o], aabb.m_maxZ[o]};
+    SevenScalar(mini, maxi, &sevenMin[o], &sevenMax[o]);
+  }
+}
+
+// In place, from AABBs already padded out to a float4 per side: the unused fourth lane
+// is where the diagonal plane goes, so the AABB columns become the 7-sided columns
+// without a second copy of the data ever existing.
+void SevenInPlace(float4* aabbMin, float4* aabbMax, int first, int end)
+{
+  int o = first;
+  for(; o + 4 <= end; o += 4)
+  {
+    __m128 minX = aabbMin[o + 0].abcd, minY = aabbMin[o + 1].abcd, minZ = aabbMin[o + 2].abcd, minD = aabbMin[o + 3].abcd;
+    __m128 maxX = aabbMax[o + 0].abcd, maxY = aabbMax[o + 1].abcd, maxZ = aabbMax[o + 2].abcd, maxD = aabbMax[o + 3].abcd;
+    _MM_TRANSPOSE4_PS(minX, minY, minZ, minD);
+    _MM_TRANSPOSE4_PS(maxX, maxY, maxZ, maxD);
+    StoreSeven<false>(minX, minY, minZ, maxX, maxY, maxZ, aabbMin + o, aabbMax + o);
+  }
+  for(; o < end; ++o)
+  {
+    const float3 mini = {aabbMin[o].a, aabbMin[o].b, aabbMin[o].c};
+    const float3 maxi = {aabbMax[o].a, aabbMax[o].b, aabbMax[o].c};
+    SevenScalar(mini, maxi, &aabbMin[o], &aabbMax[o]);
+  }
+}
+
+bool Same(const float4* a, const float4* b, int count)
+{
+  return memcmp(a, b, count * sizeof(float4)) == 0;
+}
+
+int main(int argc, char* argv[])
+{
+  Mesh mesh;
+  mesh.Generate(100, 1.0f);
+
+  const int kTests = 100;
+  const int kBatch = 4096; // objects per batch of bounds handed over by the pipeline
+
+  const int kObjects = 10000000;
+  std::vector<Object> objects(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    objects[o].m_mesh = &mesh;
+    objects[o].m_position.x = random(-50.f, 50.f);
+    objects[o].m_position.y = random(-50.f, 50.f);
+    objects[o].m_position.z = random(-50.f, 50.f);
+  }
+
+  float3* aabbMin = new float3[kObjects];
+  float3* aabbMax = new float3[kObjects];
+  for(int a = 0; a < kObjects; ++a)
+    objects[a].CalculateAABB(&aabbMin[a], &aabbMax[a]);
+
+  std::vector<float> soa(6 * kObjects);
+  AABBColumns aabb;
+  float** const column[6] = {&aabb.m_minX, &aabb.m_minY, &aabb.m_minZ, &aabb.m_maxX, &aabb.m_maxY, &aabb.m_maxZ};
+  for(int c = 0; c < 6; ++c)
+    *column[c] = soa.data() + c * kObjects;
+  for(int a = 0; a < kObjects; ++a)
+  {
+    aabb.m_minX[a] = aabbMin[a].x;
+    aabb.m_minY[a] = aabbMin[a].y;
+    aabb.m_minZ[a] = aabbMin[a].z;
+    aabb.m_maxX[a] = aabbMax[a].x;
+    aabb.m_maxY[a] = aabbMax[a].y;
+    aabb.m_maxZ[a] = aabbMax[a].z;
+  }
+
+  float4* referenceMin = new float4[kObjects];
+  float4* referenceMax = new float4[kObjects];
+  float4* sevenMin = new float4[kObjects];
+  float4* sevenMax = new float4[kObjects];
+  // fault every page in before anything is timed
+  std::fill(referenceMin, referenceMin + kObjects, float4());
+  std::fill(referenceMax, referenceMax + kObjects, float4());
+  std::fill(sevenMin, sevenMin + kObjects, float4());
+  std::fill(sevenMax, sevenMax + kObjects, float4());
+
+  const char *title = "%34s | %7s | %5s\n";
+  const char *format = "%34s | %7.4f | %5s\n";
+  printf(title, "Conversion", "seconds", "exact");
+  printf("---------------------------------------------------\n");
+
+  {
+    const Clock clock;
+    for(int a = 0; a < kObjects; ++a)
+      SevenScalar(aabbMin[a], aabbMax[a], &referenceMin[a], &referenceMax[a]);
+    const float seconds = clock.seconds();
+    printf(format, "scalar, as aabo.cpp", seconds, "-");
+  }
+
+  {
+    const Clock clock;
+    SevenFromAoS<false>(aabbMin, aabbMax, 0, kObjects, sevenMin, sevenMax);
+    const float seconds = clock.seconds();
+    const bool exact = Same(sevenMin, referenceMin, kObjects) && Same(sevenMax, referenceMax, kObjects);
+    printf(format, "float3 columns", seconds, exact ? "yes" : "NO");
+  }
+
+  {
+    const Clock clock;
+    SevenFromAoS<true>(aabbMin, aabbMax, 0, kObjects, sevenMin, sevenMax);
+    _mm_sfence();
+    const float seconds = clock.seconds();
+    const bool exact = Same(sevenMin, referenceMin, kObjects) && Same(sevenMax, referenceMax, kObjects);
+    printf(format, "float3 columns, streaming stores", seconds, exact ? "yes" : "NO");
+  }
+
+  {
+    const Clock clock;
+    SevenFromSoA<false>(aabb, 0, kObjects, sevenMin, sevenMax);
+    const float seconds = clock.seconds();
+    const bool exact = Same(sevenMin, referenceMin, kObjects) && Same(sevenMax, referenceMax, kObjects);
+    printf(format, "coordinate columns", seconds, exact ? "yes" : "NO");
+  }
+
+  {
+    const Clock clock;
+    SevenFromSoA<true>(aabb, 0, kObjects, sevenMin, sevenMax);
+    _mm_sfence();
+    const float seconds = clock.seconds();
+    const bool exact = Same(sevenMin, referenceMin, kObjects) && Same(sevenMax, referenceMax, kObjects);
+    printf(format, "coordinate columns, streaming", seconds, exact ? "yes" : "NO");
+  }
+
+  {
+    // the padded AABBs are written where the 7-sided columns will live
+    for(int a = 0; a < kObjects; ++a)
+    {
+      sevenMin[a].a = aabbMin[a].x;
+      sevenMin[a].b = aabbMin[a].y;
+      sevenMin[a].c = aabbMin[a].z;
+      sevenMax[a].a = aabbMax[a].x;
+      sevenMax[a].b = aabbMax[a].y;
+      sevenMax[a].c = aabbMax[a].z;
+    }
+    const Clock clock;
+    SevenInPlace(sevenMin, sevenMax, 0, kObjects);
+    const float seconds = clock.seconds();
+    const bool exact = Same(sevenMin, referenceMin, kObjects) && Same(sevenMax, referenceMax, kObjects);
+    printf(format, "padded float4, in place", seconds, exact ? "yes" : "NO");
+  }
+
+  {
+    // the bounds pass and the conversion interleaved a batch at a time, so each batch
+    // of AABBs is converted while it is still in cache
+    const Clock clock;
+    for(int first = 0; first < kObjects; first += kBatch)
+    {
+      const int end = std::min(first + kBatch, kObjects);
+      for(int a = first; a < end; ++a)
+        objects[a].CalculateAABB(&aabbMin[a], &aabbMax[a]);
+      SevenFromAoS<true>(aabbMin, aabbMax, first, end, sevenMin, sevenMax);
+    }
+    _mm_sfence();
+    const float seconds = clock.seconds();
+    const bool exact = Same(sevenMin, referenceMin, kObjects) && Same(sevenMax, referenceMax, kObjects);
+    printf(format, "AABB pass + conversion, batched", seconds, exact ? "yes" : "NO");
+  }
+
+  {
+    const Clock clock;
+    for(int a = 0; a < kObjects; ++a)
+      objects[a].CalculateAABB(&aabbMin[a], &aabbMax[a]);
+    const float seconds = clock.seconds();
+    printf(format, "AABB pass alone", seconds, "-");
+  }
+
+  printf("\n");
+  printf("%34s | %7s | %7s\n", "Query", "accepts", "seconds");
+  printf("-----------------------------------------------------\n");
+
+  {
+    const Clock clock;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+    {
+      const float3 queryMin = aabbMin[test];
+      const float3 queryMax = aabbMax[test];
+      for(int t = 0; t < kObjects; ++t)
+      {
+        const float3 objectMin = aabbMin[t];
+        if(objectMin.x <= queryMax.x
+        && objectMin.y <= queryMax.y
+        && objectMin.z <= queryMax.z)
+        {
+          const float3 objectMax = aabbMax[t];
+          if(queryMin.x <= objectMax.x
+          && queryMin.y <= objectMax.y
+          && queryMin.z <= objectMax.z)
+            ++intersections;
+        }
+      }
+    }
+    const float seconds = clock.seconds();
+    printf("%34s | %7d | %7.4f\n", "AABB", intersections, seconds);
+  }
+
+  {
+    // both diagonal planes are implied by the AABB test, so this accepts exactly what the
+    // AABB does; the up side's plane only makes more of the rejections happen before the
+    // down side is read
+    const Clock clock;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+    {
+      const float4 queryMin = sevenMin[test];
+      const float4 queryMax = sevenMax[test];
+      for(int t = 0; t < kObjects; ++t)
+      {
+        const float4 objectMin = sevenMin[t];
+        if(objectMin <= queryMax)
+        {
+          const float4 objectMax = sevenMax[t];
+          if(queryMin <= objectMax)
+            ++intersections;
+        }
+      }
+    }
+    const float seconds = clock.seconds();
+    printf("%34s | %7d | %7.4f\n", "7-sided, from converted columns", intersections, seconds);
+  }
+  return 0;
+}
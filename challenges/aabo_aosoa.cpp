@@ -0,0 +1,428 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include <immintrin.h>
+
+struct Clock
+{
+  const clock_t m_start;
+  Clock() : m_start(clock())
+  {
+  }
+  float seconds() const
+  {
+    const clock_t end = clock();
+    const float seconds = ((float)(end - m_start)) / CLOCKS_PER_SEC;
+    return seconds;
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+uint32_t Part1By2(uint32_t x)
+{
+  x &= 0x000003ff;
+  x = (x ^ (x << 16)) & 0xff0000ff;
+  x = (x ^ (x <<  8)) & 0x0300f00f;
+  x = (x ^ (x <<  4)) & 0x030c30c3;
+  x = (x ^ (x <<  2)) & 0x09249249;
+  return x;
+}
+
+// Sorts objects by the Morton code of the A, B and C of their AABO centroid,
+// so that the objects sharing a block are near each other.
+std::vector<int> MortonOrder(const std::vector<AABT>& aabtMin, const std::vector<AABT>& aabtMax)
+{
+  float4 lo = aabtMin[0];
+  float4 hi = aabtMax[0];
+  for(int o = 1; o < aabtMin.size(); ++o)
+  {
+    lo = min(lo, aabtMin[o]);
+    hi = max(hi, aabtMax[o]);
+  }
+  // a scene flat along an axis would divide by zero there
+  const float4 size = {std::max(hi.a - lo.a, 1e-6f), std::max(hi.b - lo.b, 1e-6f), std::max(hi.c - lo.c, 1e-6f), 0.f};
+  std::vector<uint64_t> keyed(aabtMin.size());
+  for(int o = 0; o < keyed.size(); ++o)
+  {
+    const float a = ((aabtMin[o].a + aabtMax[o].a) * 0.5f - lo.a) / size.a * 1023.f;
+    const float b = ((aabtMin[o].b + aabtMax[o].b) * 0.5f - lo.b) / size.b * 1023.f;
+    const float c = ((aabtMin[o].c + aabtMax[o].c) * 0.5f - lo.c) / size.c * 1023.f;
+    const uint32_t code = Part1By2((uint32_t)a) | (Part1By2((uint32_t)b) << 1) | (Part1By2((uint32_t)c) << 2);
+    keyed[o] = ((uint64_t)code << 32) | o;
+  }
+  std::sort(keyed.begin(), keyed.end());
+  std::vector<int> order(keyed.size());
+  for(int o = 0; o < order.size(); ++o)
+    order[o] = (int)keyed[o];
+  return order;
+}
+
+const int kLanes = 8; // objects per block, one AVX register per column
+
+// The up tetrahedra of a block of objects, one column per axis, after a summary
+// up and down tetrahedron that enclose every object in the block.
+// If a probe misses the summary, none of the columns are tested.
+struct alignas(32) UpBlock
+{
+  AABT m_summaryMin;
+  AABT m_summaryMax;
+  __m256 m_minA, m_minB, m_minC, m_minD;
+};
+
+// The down tetrahedra of the same objects, in a separate array, so they
+// aren't read unless some object in the block passes its up test.
+struct alignas(32) DownBlock
+{
+  __m256 m_maxA, m_maxB, m_maxC, m_maxD;
+};
+
+struct Octahedra
+{
+  std::vector<UpBlock> m_up;
+  std::vector<DownBlock> m_down;
+  int m_objects;
+
+  void Build(const std::vector<AABT>& aabtMin, const std::vector<AABT>& aabtMax)
+  {
+    m_objects = aabtMin.size();
+    const int blocks = (m_objects + kLanes - 1) / kLanes;
+    m_up.resize(blocks);
+    m_down.resize(blocks);
+    for(int b = 0; b < blocks; ++b)
+    {
+      // unused lanes get an empty octahedron, which no probe intersects
+      for(int lane = 0; lane < kLanes; ++lane)
+      {
+        float4 mini, maxi;
+        mini.abcd = _mm_set1_ps(INFINITY);
+        maxi.abcd = _mm_set1_ps(-INFINITY);
+        if(b * kLanes + lane < m_objects)
+        {
+          mini = aabtMin[b * kLanes + lane];
+          maxi = aabtMax[b * kLanes + lane];
+        }
+        Set(b, lane, mini, maxi);
+      }
+      Summarize(b);
+    }
+  }
+
+  void Set(int block, int lane, const AABT mini, const AABT maxi)
+  {
+    UpBlock& up = m_up[block];
+    DownBlock& down = m_down[block];
+    ((float*)&up.m_minA)[lane] = mini.a;
+    ((float*)&up.m_minB)[lane] = mini.b;
+    ((float*)&up.m_minC)[lane] = mini.c;
+    ((float*)&up.m_minD)[lane] = mini.d;
+    ((float*)&down.m_maxA)[lane] = maxi.a;
+    ((float*)&down.m_maxB)[lane] = maxi.b;
+    ((float*)&down.m_maxC)[lane] = maxi.c;
+    ((float*)&down.m_maxD)[lane] = maxi.d;
+  }
+
+  static float HorizontalMin(const __m256 v)
+  {
+    __m128 m = _mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+    return _mm_cvtss_f32(m);
+  }
+
+  static float HorizontalMax(const __m256 v)
+  {
+    __m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+    return _mm_cvtss_f32(m);
+  }
+
+  void Summarize(int block)
+  {
+    UpBlock& up = m_up[block];
+    const DownBlock& down = m_down[block];
+    up.m_summaryMin.a = HorizontalMin(up.m_minA);
+    up.m_summaryMin.b = HorizontalMin(up.m_minB);
+    up.m_summaryMin.c = HorizontalMin(up.m_minC);
+    up.m_summaryMin.d = HorizontalMin(up.m_minD);
+    up.m_summaryMax.a = HorizontalMax(down.m_maxA);
+    up.m_summaryMax.b = HorizontalMax(down.m_maxB);
+    up.m_summaryMax.c = HorizontalMax(down.m_maxC);
+    up.m_summaryMax.d = HorizontalMax(down.m_maxD);
+  }
+
+  // Moving an object only touches its own block: one lane and one summary.
+  // There is no hierarchy above the blocks to refit.
+  void Update(int object, const AABT mini, const AABT maxi)
+  {
+    Set(object / kLanes, object % kLanes, mini, maxi);
+    Summarize(object / kLanes);
+  }
+
+  int Intersections(const AABT probeMin, const AABT probeMax, bool summaries, int* visited) const
+  {
+    const __m256 maxA = _mm256_set1_ps(probeMax.a);
+    const __m256 maxB = _mm256_set1_ps(probeMax.b);
+    const __m256 maxC = _mm256_set1_ps(probeMax.c);
+    const __m256 maxD = _mm256_set1_ps(probeMax.d);
+    const __m256 minA = _mm256_set1_ps(probeMin.a);
+    const __m256 minB = _mm256_set1_ps(probeMin.b);
+    const __m256 minC = _mm256_set1_ps(probeMin.c);
+    const __m256 minD = _mm256_set1_ps(probeMin.d);
+    int intersections = 0;
+    for(int b = 0; b < m_up.size(); ++b)
+    {
+      const UpBlock& up = m_up[b];
+      if(summaries && !(up.m_summaryMin <= probeMax && probeMin <= up.m_summaryMax))
+        continue;
+      ++*visited;
+      __m256 pass = _mm256_cmp_ps(up.m_minA, maxA, _CMP_LE_OQ);
+      pass = _mm256_and_ps(pass, _mm256_cmp_ps(up.m_minB, maxB, _CMP_LE_OQ));
+      pass = _mm256_and_ps(pass, _mm256_cmp_ps(up.m_minC, maxC, _CMP_LE_OQ));
+      pass = _mm256_and_ps(pass, _mm256_cmp_ps(up.m_minD, maxD, _CMP_LE_OQ));
+      if(_mm256_movemask_ps(pass) == 0)
+        continue;
+      const DownBlock& down = m_down[b];
+      pass = _mm256_and_ps(pass, _mm256_cmp_ps(minA, down.m_maxA, _CMP_LE_OQ));
+      pass = _mm256_and_ps(pass, _mm256_cmp_ps(minB, down.m_maxB, _CMP_LE_OQ));
+      pass = _mm256_and_ps(pass, _mm256_cmp_ps(minC, down.m_maxC, _CMP_LE_OQ));
+      pass = _mm256_and_ps(pass, _mm256_cmp_ps(minD, down.m_maxD, _CMP_LE_OQ));
+      intersections += _mm_popcnt_u32(_mm256_movemask_ps(pass));
+    }
+    return intersections;
+  }
+};
+
+int main(int argc, char* argv[])
+{
+  Mesh mesh;
+  mesh.Generate(100, 1.0f);
+
+  const int kTests = 100;
+
+  const int kObjects = 10000000;
+  std::vector<Object> objects(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    objects[o].m_mesh = &mesh;
+    objects[o].m_position.x = random(-50.f, 50.f);
+    objects[o].m_position.y = random(-50.f, 50.f);
+    objects[o].m_position.z = random(-50.f, 50.f);
+  }
+
+  std::vector<AABT> aabtMin(kObjects);
+  std::vector<AABT> aabtMax(kObjects);
+  for(int a = 0; a < kObjects; ++a)
+    objects[a].CalculateAABT(&aabtMin[a], &aabtMax[a]);
+
+  const std::vector<AABT> probeMin(aabtMin.begin(), aabtMin.begin() + kTests);
+  const std::vector<AABT> probeMax(aabtMax.begin(), aabtMax.begin() + kTests);
+
+  {
+    const std::vector<int> order = MortonOrder(aabtMin, aabtMax);
+    std::vector<Object> sortedObjects(kObjects);
+    std::vector<AABT> sortedMin(kObjects), sortedMax(kObjects);
+    for(int o = 0; o < kObjects; ++o)
+    {
+      sortedObjects[o] = objects[order[o]];
+      sortedMin[o] = aabtMin[order[o]];
+      sortedMax[o] = aabtMax[order[o]];
+    }
+    objects.swap(sortedObjects);
+    aabtMin.swap(sortedMin);
+    aabtMax.swap(sortedMax);
+  }
+
+  {
+    const Clock clock;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+    {
+      const AABT queryMin = probeMin[test];
+      const AABT queryMax = probeMax[test];
+      for(int t = 0; t < kObjects; ++t)
+      {
+        const AABT targetMin = aabtMin[t];
+        if(targetMin <= queryMax)
+        {
+	  const AABT targetMax = aabtMax[t];
+	  if(queryMin <= targetMax)
+	    ++intersections;
+        }
+      }
+    }
+    const float seconds = clock.seconds();
+
+    printf("AABO SIMD reported %d intersections in %f seconds\n", intersections, seconds);
+  }
+
+  Octahedra octahedra;
+  octahedra.Build(aabtMin, aabtMax);
+  const int blocks = octahedra.m_up.size();
+
+  {
+    const Clock clock;
+    int intersections = 0;
+    int visited = 0;
+    for(int test = 0; test < kTests; ++test)
+      intersections += octahedra.Intersections(probeMin[test], probeMax[test], false, &visited);
+    const float seconds = clock.seconds();
+
+    printf("AABO AoSoA x%d reported %d intersections in %f seconds\n", kLanes, intersections, seconds);
+  }
+
+  {
+    const Clock clock;
+    int intersections = 0;
+    int visited = 0;
+    for(int test = 0; test < kTests; ++test)
+      intersections += octahedra.Intersections(probeMin[test], probeMax[test], true, &visited);
+    const float seconds = clock.seconds();
+
+    printf("AABO AoSoA x%d with summaries reported %d intersections in %f seconds, visiting %.2f%% of blocks\n",
+           kLanes, intersections, seconds, 100.f * visited / ((float)blocks * kTests));
+  }
+
+  {
+    // a frame of small moves for 1% of the objects
+    const int kMoves = kObjects / 100;
+    std::vector<int> moved(kMoves);
+    for(int m = 0; m < kMoves; ++m)
+    {
+      const int o = rand() % kObjects;
+      objects[o].m_position.x += random(-0.1f, 0.1f);
+      objects[o].m_position.y += random(-0.1f, 0.1f);
+      objects[o].m_position.z += random(-0.1f, 0.1f);
+      objects[o].CalculateAABT(&aabtMin[o], &aabtMax[o]);
+      moved[m] = o;
+    }
+
+    const Clock clock;
+    for(int m = 0; m < kMoves; ++m)
+      octahedra.Update(moved[m], aabtMin[moved[m]], aabtMax[moved[m]]);
+    const float seconds = clock.seconds();
+
+    int intersections = 0;
+    int visited = 0;
+    for(int test = 0; test < kTests; ++test)
+      intersections += octahedra.Intersections(probeMin[test], probeMax[test], true, &visited);
+
+    int expected = 0;
+    for(int test = 0; test < kTests; ++test)
+      for(int t = 0; t < kObjects; ++t)
+        if(aabtMin[t] <= probeMax[test] && probeMin[test] <= aabtMax[t])
+          ++expected;
+
+    printf("AABO AoSoA x%d updated %d moved objects in %f seconds, then reported %d intersections (expected %d)\n", kLanes, kMoves, seconds, intersections, expected);
+  }
+  return 0;
+}
@@ -0,0 +1,506 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+#include <immintrin.h>
+
+struct Clock
+{
+  const clock_t m_start;
+  Clock() : m_start(clock())
+  {
+  }
+  float seconds() const
+  {
+    const clock_t end = clock();
+    const float seconds = ((float)(end - m_start)) / CLOCKS_PER_SEC;
+    return seconds;
+  }
+};
+
+struct float2
+{
+  float x,y;
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+float3 min(const float3 a, const float3 b)
+{
+  float3 c = {std::min(a.x,b.x), std::min(a.y,b.y), std::min(a.z,b.z)};
+  return c;
+}
+
+float3 max(const float3 a, const float3 b)
+{
+  float3 c = {std::max(a.x,b.x), std::max(a.y,b.y), std::max(a.z,b.z)};
+  return c;
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABB(float3* mini, float3* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyz;
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      *mini = min(*mini, xyz);
+      *maxi = max(*maxi, xyz);
+    }
+  }
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+// One aligned region that columns are bump-allocated out of. Dropping it frees every column
+// at once, and Reset() empties it for reuse without giving the memory back at all.
+// An arena can be moved but not copied, so a scene can't be duplicated by accident.
+// Running out of memory, or out of arena, is not something a benchmark can recover
+// from, so either one ends the program with a message.
+class Arena
+{
+public:
+  static const size_t kAlignment = 64;
+
+  Arena() : m_base(0), m_size(0), m_used(0)
+  {
+  }
+  explicit Arena(size_t size) : m_base((char*)aligned_alloc(kAlignment, Round(size))), m_size(Round(size)), m_used(0)
+  {
+    if(!m_base && m_size)
+    {
+      fprintf(stderr, "can't allocate an arena of %zu bytes: %s\n", m_size, strerror(errno));
+      exit(1);
+    }
+  }
+  Arena(Arena&& other) : m_base(other.m_base), m_size(other.m_size), m_used(other.m_used)
+  {
+    other.m_base = 0;
+    other.m_size = other.m_used = 0;
+  }
+  Arena& operator=(Arena&& other)
+  {
+    std::swap(m_base, other.m_base);
+    std::swap(m_size, other.m_size);
+    std::swap(m_used, other.m_used);
+    return *this;
+  }
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  ~Arena()
+  {
+    free(m_base);
+  }
+
+  static size_t Round(size_t bytes)
+  {
+    return (bytes + kAlignment - 1) / kAlignment * kAlignment;
+  }
+
+  // Columns are plain old data, so nothing is constructed and nothing will be destroyed.
+  // Each column is followed by one spare cache line. Column sizes are usually multiples of
+  // 4KB, and without the skew, a loop walking several of them in step would hit the same
+  // cache set in every one of them.
+  template<typename T> T* Allocate(size_t count)
+  {
+    const size_t bytes = Round(count * sizeof(T)) + kAlignment;
+    if(m_used + bytes > m_size)
+    {
+      fprintf(stderr, "arena of %zu bytes has no room for %zu more\n", m_size, bytes);
+      exit(1);
+    }
+    T* column = (T*)(m_base + m_used);
+    m_used += bytes;
+    return column;
+  }
+
+  void Reset()
+  {
+    m_used = 0;
+  }
+
+  size_t Size() const
+  {
+    return m_size;
+  }
+
+private:
+  char* m_base;
+  size_t m_size;
+  size_t m_used;
+};
+
+// Every bounding volume column of one generation of the scene, as aabo.cpp lays them out,
+// all carved out of the same arena. Building the next generation and dropping this one
+// is one allocation and one free, however many columns there are.
+class Scene
+{
+public:
+  int m_objects;
+  float3* m_aabbMin;
+  float3* m_aabbMax;
+  float2* m_aabbX;
+  float2* m_aabbY;
+  float2* m_aabbZ;
+  AABT* m_aabtMin;
+  AABT* m_aabtMax;
+  float4* m_sevenMin;
+  float4* m_sevenMax;
+
+  static const int kColumns = 9;
+
+  static size_t Bytes(int objects)
+  {
+    return 2 * Arena::Round(objects * sizeof(float3))
+         + 3 * Arena::Round(objects * sizeof(float2))
+         + 4 * Arena::Round(objects * sizeof(float4))
+         + kColumns * Arena::kAlignment;
+  }
+
+  // Builds into a recycled arena if it is big enough, and into a new one otherwise.
+  Scene(const std::vector<Object>& objects, Arena&& recycled = Arena())
+  : m_objects(objects.size()), m_arena(std::move(recycled))
+  {
+    if(m_arena.Size() < Bytes(m_objects))
+      m_arena = Arena(Bytes(m_objects));
+    m_arena.Reset();
+    m_aabbMin = m_arena.Allocate<float3>(m_objects);
+    m_aabbMax = m_arena.Allocate<float3>(m_objects);
+    m_aabbX = m_arena.Allocate<float2>(m_objects);
+    m_aabbY = m_arena.Allocate<float2>(m_objects);
+    m_aabbZ = m_arena.Allocate<float2>(m_objects);
+    m_aabtMin = m_arena.Allocate<AABT>(m_objects);
+    m_aabtMax = m_arena.Allocate<AABT>(m_objects);
+    m_sevenMin = m_arena.Allocate<float4>(m_objects);
+    m_sevenMax = m_arena.Allocate<float4>(m_objects);
+    Calculate(objects, m_aabbMin, m_aabbMax, m_aabbX, m_aabbY, m_aabbZ, m_aabtMin, m_aabtMax, m_sevenMin, m_sevenMax);
+  }
+  // The columns point into the arena, so they go with it, and the scene left behind is
+  // empty rather than pointing into memory it no longer owns.
+  Scene(Scene&& other) : m_arena(std::move(other.m_arena))
+  {
+    Take(other);
+  }
+  Scene& operator=(Scene&& other)
+  {
+    m_arena = std::move(other.m_arena);
+    Take(other);
+    return *this;
+  }
+  Scene(const Scene&) = delete;
+  Scene& operator=(const Scene&) = delete;
+
+  // Gives up the memory so the next generation can be built in it.
+  Arena Retire()
+  {
+    Clear();
+    return std::move(m_arena);
+  }
+
+  static void Calculate(const std::vector<Object>& objects, float3* aabbMin, float3* aabbMax, float2* aabbX, float2* aabbY, float2* aabbZ,
+                        AABT* aabtMin, AABT* aabtMax, float4* sevenMin, float4* sevenMax)
+  {
+    for(int o = 0; o < objects.size(); ++o)
+    {
+      // into locals first: the columns are only pointers into an arena, so the compiler has
+      // to assume every store into them might change the mesh and reload it each point
+      float3 mini, maxi;
+      AABT abcdMin, abcdMax;
+      objects[o].CalculateAABB(&mini, &maxi);
+      objects[o].CalculateAABT(&abcdMin, &abcdMax);
+      aabbMin[o] = mini;
+      aabbMax[o] = maxi;
+      aabtMin[o] = abcdMin;
+      aabtMax[o] = abcdMax;
+      aabbX[o].x = mini.x;
+      aabbX[o].y = maxi.x;
+      aabbY[o].x = mini.y;
+      aabbY[o].y = maxi.y;
+      aabbZ[o].x = mini.z;
+      aabbZ[o].y = maxi.z;
+      sevenMin[o].a = mini.x;
+      sevenMin[o].b = mini.y;
+      sevenMin[o].c = mini.z;
+      sevenMin[o].d = -(maxi.x + maxi.y + maxi.z);
+      sevenMax[o].a = maxi.x;
+      sevenMax[o].b = maxi.y;
+      sevenMax[o].c = maxi.z;
+      sevenMax[o].d = -(mini.x + mini.y + mini.z);
+    }
+  }
+
+  int Intersections(int tests) const
+  {
+    int intersections = 0;
+    for(int test = 0; test < tests; ++test)
+    {
+      const AABT probeMin = m_aabtMin[test];
+      const AABT probeMax = m_aabtMax[test];
+      for(int t = 0; t < m_objects; ++t)
+      {
+        const AABT targetMin = m_aabtMin[t];
+        if(targetMin <= probeMax)
+        {
+          const AABT targetMax = m_aabtMax[t];
+          if(probeMin <= targetMax)
+            ++intersections;
+        }
+      }
+    }
+    return intersections;
+  }
+
+private:
+  void Take(Scene& other)
+  {
+    m_objects = other.m_objects;
+    m_aabbMin = other.m_aabbMin;
+    m_aabbMax = other.m_aabbMax;
+    m_aabbX = other.m_aabbX;
+    m_aabbY = other.m_aabbY;
+    m_aabbZ = other.m_aabbZ;
+    m_aabtMin = other.m_aabtMin;
+    m_aabtMax = other.m_aabtMax;
+    m_sevenMin = other.m_sevenMin;
+    m_sevenMax = other.m_sevenMax;
+    other.Clear();
+  }
+
+  void Clear()
+  {
+    m_objects = 0;
+    m_aabbMin = m_aabbMax = 0;
+    m_aabbX = m_aabbY = m_aabbZ = 0;
+    m_aabtMin = m_aabtMax = 0;
+    m_sevenMin = m_sevenMax = 0;
+  }
+
+  Arena m_arena;
+};
+
+// Seeded by generation, so every allocation scheme sees the same motion.
+void Move(std::vector<Object>& objects, int generation)
+{
+  srand(generation + 1);
+  for(int o = 0; o < objects.size(); ++o)
+  {
+    objects[o].m_position.x += random(-0.1f, 0.1f);
+    objects[o].m_position.y += random(-0.1f, 0.1f);
+    objects[o].m_position.z += random(-0.1f, 0.1f);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  Mesh mesh;
+  mesh.Generate(100, 1.0f);
+
+  const int kTests = 10;
+  const int kGenerations = 4;
+
+  const int kObjects = 10000000;
+  std::vector<Object> objects(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    objects[o].m_mesh = &mesh;
+    objects[o].m_position.x = random(-50.f, 50.f);
+    objects[o].m_position.y = random(-50.f, 50.f);
+    objects[o].m_position.z = random(-50.f, 50.f);
+  }
+  const std::vector<Object> start = objects;
+
+  const char *title = "%32s | %10s | %10s | %7s\n";
+  const char *format = "%32s | %10.4f | %10.4f | %7d\n";
+  printf(title, "Allocation", "build", "release", "accepts");
+  printf("-------------------------------------------------------------------\n");
+
+  {
+    // what aabo.cpp does, plus the delete[]s it leaves out: a heap block per column
+    float build = 0.f, release = 0.f;
+    int intersections = 0;
+    for(int generation = 0; generation < kGenerations; ++generation)
+    {
+      Clock building;
+      float3* aabbMin = new float3[kObjects];
+      float3* aabbMax = new float3[kObjects];
+      float2* aabbX = new float2[kObjects];
+      float2* aabbY = new float2[kObjects];
+      float2* aabbZ = new float2[kObjects];
+      AABT* aabtMin = new AABT[kObjects];
+      AABT* aabtMax = new AABT[kObjects];
+      float4* sevenMin = new float4[kObjects];
+      float4* sevenMax = new float4[kObjects];
+      Scene::Calculate(objects, aabbMin, aabbMax, aabbX, aabbY, aabbZ, aabtMin, aabtMax, sevenMin, sevenMax);
+      build += building.seconds();
+
+      for(int test = 0; test < kTests; ++test)
+        for(int t = 0; t < kObjects; ++t)
+          if(aabtMin[t] <= aabtMax[test] && aabtMin[test] <= aabtMax[t])
+            ++intersections;
+      Move(objects, generation);
+
+      Clock releasing;
+      delete[] aabbMin;
+      delete[] aabbMax;
+      delete[] aabbX;
+      delete[] aabbY;
+      delete[] aabbZ;
+      delete[] aabtMin;
+      delete[] aabtMax;
+      delete[] sevenMin;
+      delete[] sevenMax;
+      release += releasing.seconds();
+    }
+    printf(format, "new[] per column", build, release, intersections);
+  }
+
+  objects = start;
+  {
+    float build = 0.f, release = 0.f;
+    int intersections = 0;
+    for(int generation = 0; generation < kGenerations; ++generation)
+    {
+      Clock building;
+      Scene* scene = new Scene(objects);
+      build += building.seconds();
+
+      intersections += scene->Intersections(kTests);
+      Move(objects, generation);
+
+      Clock releasing;
+      delete scene;
+      release += releasing.seconds();
+    }
+    printf(format, "arena per generation", build, release, intersections);
+  }
+
+  objects = start;
+  {
+    // the retired generation's arena is reused, so after the first build nothing is
+    // allocated, and the pages are already faulted in
+    float build = 0.f, release = 0.f;
+    int intersections = 0;
+    Arena spare;
+    for(int generation = 0; generation < kGenerations; ++generation)
+    {
+      Clock building;
+      Scene scene(objects, std::move(spare));
+      build += building.seconds();
+
+      intersections += scene.Intersections(kTests);
+      Move(objects, generation);
+
+      Clock releasing;
+      spare = scene.Retire();
+      release += releasing.seconds();
+    }
+    printf(format, "arena recycled between generations", build, release, intersections);
+  }
+  return 0;
+}
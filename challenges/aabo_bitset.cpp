@@ -0,0 +1,409 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <immintrin.h>
+
+struct Clock
+{
+  const clock_t m_start;
+  Clock() : m_start(clock())
+  {
+  }
+  float seconds() const
+  {
+    const clock_t end = clock();
+    const float seconds = ((float)(end - m_start)) / CLOCKS_PER_SEC;
+    return seconds;
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+// One bit per object, set if the object's whole up side is <= the query's max, or its whole
+// down side is >= the query's min: the four lane bits of each object are ANDed together and
+// gathered into one bit with pext. kStep objects make a whole number of bytes, so a group's
+// result goes into the bitset with one store.
+#if defined(__AVX512F__) && defined(__BMI2__)
+const int kStep = 16;
+
+unsigned Up(const float4* column, const float4 queryMax)
+{
+  const __m512 query = _mm512_maskz_broadcast_f32x4(0xFFFF, queryMax.abcd);
+  unsigned objects = 0;
+  for(int r = 0; r < 4; ++r)
+  {
+    const unsigned lanes = _mm512_cmp_ps_mask(_mm512_loadu_ps((const float*)&column[r * 4]), query, _CMP_LE_OQ);
+    objects |= _pext_u32(lanes & (lanes >> 1) & (lanes >> 2) & (lanes >> 3), 0x1111) << (r * 4);
+  }
+  return objects;
+}
+
+unsigned Down(const float4* column, const float4 queryMin)
+{
+  const __m512 query = _mm512_maskz_broadcast_f32x4(0xFFFF, queryMin.abcd);
+  unsigned objects = 0;
+  for(int r = 0; r < 4; ++r)
+  {
+    const unsigned lanes = _mm512_cmp_ps_mask(query, _mm512_loadu_ps((const float*)&column[r * 4]), _CMP_LE_OQ);
+    objects |= _pext_u32(lanes & (lanes >> 1) & (lanes >> 2) & (lanes >> 3), 0x1111) << (r * 4);
+  }
+  return objects;
+}
+
+// The bitset is stored as 64-bit words, so the 16 bits of a group go through memcpy rather
+// than a uint16_t pointer, which would break strict aliasing. It compiles to one load or store.
+void Store(uint8_t* bytes, unsigned objects)
+{
+  const uint16_t bits = objects;
+  memcpy(bytes, &bits, sizeof(bits));
+}
+
+unsigned Load(const uint8_t* bytes)
+{
+  uint16_t bits;
+  memcpy(&bits, bytes, sizeof(bits));
+  return bits;
+}
+#elif defined(__AVX__) && defined(__BMI2__)
+const int kStep = 8;
+
+unsigned Up(const float4* column, const float4 queryMax)
+{
+  const __m256 query = _mm256_broadcast_ps(&queryMax.abcd);
+  unsigned objects = 0;
+  for(int r = 0; r < 4; ++r)
+  {
+    const unsigned lanes = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps((const float*)&column[r * 2]), query, _CMP_LE_OQ));
+    objects |= _pext_u32(lanes & (lanes >> 1) & (lanes >> 2) & (lanes >> 3), 0x11) << (r * 2);
+  }
+  return objects;
+}
+
+unsigned Down(const float4* column, const float4 queryMin)
+{
+  const __m256 query = _mm256_broadcast_ps(&queryMin.abcd);
+  unsigned objects = 0;
+  for(int r = 0; r < 4; ++r)
+  {
+    const unsigned lanes = _mm256_movemask_ps(_mm256_cmp_ps(query, _mm256_loadu_ps((const float*)&column[r * 2]), _CMP_LE_OQ));
+    objects |= _pext_u32(lanes & (lanes >> 1) & (lanes >> 2) & (lanes >> 3), 0x11) << (r * 2);
+  }
+  return objects;
+}
+
+void Store(uint8_t* bytes, unsigned objects)
+{
+  *bytes = objects;
+}
+
+unsigned Load(const uint8_t* bytes)
+{
+  return *bytes;
+}
+#else
+const int kStep = 8;
+
+unsigned Up(const float4* column, const float4 queryMax)
+{
+  unsigned objects = 0;
+  for(int o = 0; o < kStep; ++o)
+    objects |= (column[o] <= queryMax) << o;
+  return objects;
+}
+
+unsigned Down(const float4* column, const float4 queryMin)
+{
+  unsigned objects = 0;
+  for(int o = 0; o < kStep; ++o)
+    objects |= (queryMin <= column[o]) << o;
+  return objects;
+}
+
+void Store(uint8_t* bytes, unsigned objects)
+{
+  *bytes = objects;
+}
+
+unsigned Load(const uint8_t* bytes)
+{
+  return *bytes;
+}
+#endif
+
+// A bit per object, in the same order as the columns, padded to whole words with zeros.
+struct Bitset
+{
+  std::vector<uint64_t> m_word;
+  int m_objects;
+
+  Bitset(int objects) : m_word((objects + 63) / 64, 0), m_objects(objects)
+  {
+  }
+
+  uint8_t* Bytes()
+  {
+    return (uint8_t*)m_word.data();
+  }
+
+  bool Test(int o) const
+  {
+    return (m_word[o / 64] >> (o % 64)) & 1;
+  }
+
+  int Count() const
+  {
+    int count = 0;
+    for(int w = 0; w < m_word.size(); ++w)
+      count += __builtin_popcountll(m_word[w]);
+    return count;
+  }
+};
+
+// How a query's bits combine with what is already in the bitset.
+enum Accumulate
+{
+  kSet, // overwrite: the objects this probe overlaps
+  kOr,  // the objects any of the probes overlaps
+  kAnd, // the objects every one of the probes overlaps
+};
+
+// The AABO query of aabo.cpp, with the result as bits. The down column is only read for
+// groups where some object passed the up test, and in kAnd mode, groups that are already
+// all zeros aren't read at all.
+template<Accumulate kMode> void Query(const float4* mins, const float4* maxs, int objects, const float4 queryMin, const float4 queryMax, Bitset* bitset)
+{
+  uint8_t* bytes = bitset->Bytes();
+  int t = 0;
+  for(; t + kStep <= objects; t += kStep)
+  {
+    unsigned before = 0;
+    if(kMode != kSet)
+      before = Load(bytes + t / 8);
+    if(kMode == kAnd && !before)
+      continue;
+    unsigned passed = Up(mins + t, queryMax);
+    if(passed)
+      passed &= Down(maxs + t, queryMin);
+    if(kMode == kOr)
+      passed |= before;
+    if(kMode == kAnd)
+      passed &= before;
+    Store(bytes + t / 8, passed);
+  }
+  for(; t < objects; ++t)
+  {
+    const uint64_t bit = 1ull << (t % 64);
+    const bool passed = mins[t] <= queryMax && queryMin <= maxs[t];
+    uint64_t& word = bitset->m_word[t / 64];
+    if(passed && kMode != kAnd)
+      word |= bit;
+    else if(!passed && kMode != kOr)
+      word &= ~bit;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  Mesh mesh;
+  mesh.Generate(100, 1.0f);
+  Mesh regionMesh; // big queries, like a view or an area of interest
+  regionMesh.Generate(200, 20.f);
+
+  const int kTests = 100;
+  const int kRegions = 4;
+
+  const int kObjects = 10000001; // not a whole number of groups, so the tail is exercised
+  std::vector<Object> objects(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    objects[o].m_mesh = &mesh;
+    objects[o].m_position.x = random(-50.f, 50.f);
+    objects[o].m_position.y = random(-50.f, 50.f);
+    objects[o].m_position.z = random(-50.f, 50.f);
+  }
+
+  std::vector<AABT> aabtMin(kObjects);
+  std::vector<AABT> aabtMax(kObjects);
+  for(int a = 0; a < kObjects; ++a)
+    objects[a].CalculateAABT(&aabtMin[a], &aabtMax[a]);
+
+  AABT regionMin[kRegions], regionMax[kRegions];
+  for(int r = 0; r < kRegions; ++r)
+  {
+    Object region;
+    region.m_mesh = &regionMesh;
+    region.m_position.x = random(-10.f, 10.f);
+    region.m_position.y = random(-10.f, 10.f);
+    region.m_position.z = random(-10.f, 10.f);
+    region.CalculateAABT(&regionMin[r], &regionMax[r]);
+  }
+
+  {
+    const Clock clock;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+    {
+      const AABT probeMin = aabtMin[test];
+      const AABT probeMax = aabtMax[test];
+      for(int t = 0; t < kObjects; ++t)
+      {
+        const AABT targetMin = aabtMin[t];
+        if(targetMin <= probeMax)
+        {
+          const AABT targetMax = aabtMax[t];
+          if(probeMin <= targetMax)
+            ++intersections;
+        }
+      }
+    }
+    const float seconds = clock.seconds();
+    printf("AABO counting loop reported %d intersections in %f seconds\n", intersections, seconds);
+  }
+
+  Bitset bitset(kObjects);
+  {
+    const Clock clock;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+    {
+      Query<kSet>(aabtMin.data(), aabtMax.data(), kObjects, aabtMin[test], aabtMax[test], &bitset);
+      intersections += bitset.Count();
+    }
+    const float seconds = clock.seconds();
+    printf("AABO bitset, %d objects per store, reported %d intersections in %f seconds\n", kStep, intersections, seconds);
+  }
+
+  // every object against every region, to check the accumulated bitsets with
+  std::vector<int> inRegions(kObjects, 0);
+  for(int t = 0; t < kObjects; ++t)
+    for(int r = 0; r < kRegions; ++r)
+      inRegions[t] += regionMin[r] <= aabtMax[t] && aabtMin[t] <= regionMax[r];
+
+  for(int mode = kOr; mode <= kAnd; ++mode)
+  {
+    const Clock clock;
+    Query<kSet>(aabtMin.data(), aabtMax.data(), kObjects, regionMin[0], regionMax[0], &bitset);
+    for(int r = 1; r < kRegions; ++r)
+      if(mode == kOr)
+        Query<kOr>(aabtMin.data(), aabtMax.data(), kObjects, regionMin[r], regionMax[r], &bitset);
+      else
+        Query<kAnd>(aabtMin.data(), aabtMax.data(), kObjects, regionMin[r], regionMax[r], &bitset);
+    const int count = bitset.Count();
+    const float seconds = clock.seconds();
+
+    int wrong = 0;
+    for(int t = 0; t < kObjects; ++t)
+      wrong += bitset.Test(t) != (mode == kOr ? inRegions[t] > 0 : inRegions[t] == kRegions);
+    printf("AABO bitset, %s of %d regions, has %d objects in %f seconds, %d bits wrong\n", mode == kOr ? "OR" : "AND", kRegions, count, seconds, wrong);
+  }
+  return 0;
+}
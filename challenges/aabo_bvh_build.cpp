@@ -0,0 +1,613 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <stdint.h>
+#include <float.h>
+#include <math.h>
+#include <immintrin.h>
+
+// The build runs on every core, and a frame budget is wall time, not the CPU time
+// clock() would add up across the builder threads.
+struct WallClock
+{
+  const std::chrono::steady_clock::time_point m_start;
+  WallClock() : m_start(std::chrono::steady_clock::now())
+  {
+  }
+  float seconds() const
+  {
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    return std::chrono::duration<float>(end - m_start).count();
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+// The SAH weighs each child by how likely a query is to reach it. For an AABO, two things
+// decide that. The up test is paid by every child of a node that is entered, and passes
+// about in proportion to the area of the up tetrahedron, whose size is -(minA+minB+minC+minD)
+// since A+B+C+D is zero everywhere. The down test is paid only by children that pass, and
+// a child is entered about in proportion to the AABO's own area, measured like an AABB's
+// xy+yz+zx, as the sum of the products of its extents along every pair of the four axes.
+const float kUpCost = 1.f;     // a 4-plane test on the up column, which is streaming in anyway
+const float kDownCost = 2.f;   // the same test, but on a line of the down column fetched for it
+const float kObjectCost = 1.2f; // an object in a leaf: an up test, and the occasional down test
+
+const int kBins = 16;
+const int kLeafMax = 8;
+const int kTaskMin = 1 << 14;     // smallest subtree handed to another thread
+const int kParallelBins = 1 << 20; // smallest node whose objects are binned by every thread
+
+float UpArea(const AABT mini)
+{
+  const float size = -(mini.a + mini.b + mini.c + mini.d);
+  return size * size;
+}
+
+float OctahedronArea(const AABT mini, const AABT maxi)
+{
+  const float e[4] = {maxi.a - mini.a, maxi.b - mini.b, maxi.c - mini.c, maxi.d - mini.d};
+  return e[0]*e[1] + e[0]*e[2] + e[0]*e[3] + e[1]*e[2] + e[1]*e[3] + e[2]*e[3];
+}
+
+struct Bounds
+{
+  AABT m_min;
+  AABT m_max;
+
+  static Bounds Empty()
+  {
+    Bounds b;
+    b.m_min.abcd = _mm_set1_ps(FLT_MAX);
+    b.m_max.abcd = _mm_set1_ps(-FLT_MAX);
+    return b;
+  }
+
+  void Grow(const AABT mini, const AABT maxi)
+  {
+    m_min.abcd = _mm_min_ps(m_min.abcd, mini.abcd);
+    m_max.abcd = _mm_max_ps(m_max.abcd, maxi.abcd);
+  }
+
+  void Grow(const Bounds& b)
+  {
+    Grow(b.m_min, b.m_max);
+  }
+};
+
+struct Node
+{
+  AABT m_min;
+  AABT m_max;
+  int m_first; // first child if m_count is 0, otherwise first object
+  int m_count;
+};
+
+// What the builder moves around: an object's bounds travel with it through every partition,
+// so each pass over a node reads memory in order instead of chasing object indices.
+struct Ref
+{
+  AABT m_min;
+  AABT m_max;
+  int m_object;
+
+  __m128 Centroid() const
+  {
+    return _mm_mul_ps(_mm_add_ps(m_min.abcd, m_max.abcd), _mm_set1_ps(0.5f));
+  }
+};
+
+struct Bin
+{
+  Bounds m_bounds;
+  int m_count;
+};
+
+// Runs work(t, threads) on the calling thread and threads-1 others.
+template<typename Work> void ParallelFor(int threads, Work work)
+{
+  std::vector<std::thread> worker;
+  for(int t = 1; t < threads; ++t)
+    worker.push_back(std::thread(work, t, threads));
+  work(0, threads);
+  for(int t = 0; t < worker.size(); ++t)
+    worker[t].join();
+}
+
+// A top-down binned SAH build over the centroids of the objects' AABOs, along whichever of
+// the A, B, C and D axes gives the cheapest split. Each subtree is built with a budget of
+// threads: the two halves of any big enough node are built as separate tasks that share
+// out the budget, and the few nodes at the top, which no task split can help with, have
+// their objects binned by every thread of theirs at once.
+class BVH
+{
+public:
+  std::vector<Node> m_node;
+  std::vector<int> m_object; // object indices, in leaf order
+  std::vector<AABT> m_aabtMin; // the objects' bounds, also in leaf order
+  std::vector<AABT> m_aabtMax;
+
+  BVH(const std::vector<AABT>& aabtMin, const std::vector<AABT>& aabtMax, int threads)
+  : m_node(std::max<size_t>(1, 2 * aabtMin.size())), m_object(aabtMin.size()), m_aabtMin(aabtMin.size()), m_aabtMax(aabtMin.size())
+  , m_ref(aabtMin.size()), m_nodes(1)
+  {
+    const int objects = aabtMin.size();
+    std::vector<Bounds> partial(threads, Bounds::Empty());
+    ParallelFor(threads, [&](int t, int threads)
+    {
+      const int first = (int64_t)objects * t / threads;
+      const int end = (int64_t)objects * (t + 1) / threads;
+      for(int o = first; o < end; ++o)
+      {
+        m_ref[o].m_min = aabtMin[o];
+        m_ref[o].m_max = aabtMax[o];
+        m_ref[o].m_object = o;
+        partial[t].Grow(aabtMin[o], aabtMax[o]);
+      }
+    });
+    Bounds root = Bounds::Empty();
+    for(int t = 0; t < threads; ++t)
+      root.Grow(partial[t]);
+    m_node[0].m_min = root.m_min;
+    m_node[0].m_max = root.m_max;
+    Build(0, 0, objects, threads);
+    m_node.resize(m_nodes);
+
+    ParallelFor(threads, [&](int t, int threads)
+    {
+      const int first = (int64_t)objects * t / threads;
+      const int end = (int64_t)objects * (t + 1) / threads;
+      for(int o = first; o < end; ++o)
+      {
+        m_object[o] = m_ref[o].m_object;
+        m_aabtMin[o] = m_ref[o].m_min;
+        m_aabtMax[o] = m_ref[o].m_max;
+      }
+    });
+    std::vector<Ref>().swap(m_ref);
+  }
+
+  // The traversal stack is the caller's, so it grows to whatever depth the tree has once,
+  // not once per query.
+  int Intersections(const AABT probeMin, const AABT probeMax, std::vector<int>* stack) const
+  {
+    int intersections = 0;
+    stack->assign(1, 0);
+    while(!stack->empty())
+    {
+      const Node& node = m_node[stack->back()];
+      stack->pop_back();
+      if(!(node.m_min <= probeMax && probeMin <= node.m_max))
+        continue;
+      if(node.m_count)
+      {
+        for(int t = node.m_first; t < node.m_first + node.m_count; ++t)
+        {
+          const AABT targetMin = m_aabtMin[t];
+          if(targetMin <= probeMax)
+          {
+            const AABT targetMax = m_aabtMax[t];
+            if(probeMin <= targetMax)
+              ++intersections;
+          }
+        }
+      }
+      else
+      {
+        stack->push_back(node.m_first + 1);
+        stack->push_back(node.m_first);
+      }
+    }
+    return intersections;
+  }
+
+  int Depth(int node = 0) const
+  {
+    return m_node[node].m_count ? 1 : 1 + std::max(Depth(m_node[node].m_first), Depth(m_node[node].m_first + 1));
+  }
+
+private:
+  std::vector<Ref> m_ref;
+  std::atomic<int> m_nodes;
+
+  // The bin of a centroid along each of the four axes.
+  static __m128i Slots(const __m128 centroid, const AABT cmin, const AABT scale, int bins)
+  {
+    const __m128i slot = _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(centroid, cmin.abcd), scale.abcd));
+    return _mm_min_epi32(_mm_max_epi32(slot, _mm_setzero_si128()), _mm_set1_epi32(bins - 1));
+  }
+
+  void CentroidBounds(int first, int end, AABT* cmin, AABT* cmax) const
+  {
+    cmin->abcd = _mm_set1_ps(FLT_MAX);
+    cmax->abcd = _mm_set1_ps(-FLT_MAX);
+    for(int i = first; i < end; ++i)
+    {
+      cmin->abcd = _mm_min_ps(cmin->abcd, m_ref[i].Centroid());
+      cmax->abcd = _mm_max_ps(cmax->abcd, m_ref[i].Centroid());
+    }
+  }
+
+  // Fills one row of bins per axis with the objects in [first, end). Four bins take every
+  // object, so while filling, a bin keeps its min and its negated max in one 8-wide register
+  // and grows with a single min.
+  void Fill(int first, int end, const AABT cmin, const AABT scale, int bins, Bin bin[4][kBins]) const
+  {
+    const __m256 negateMax = _mm256_setr_ps(0.f, 0.f, 0.f, 0.f, -0.f, -0.f, -0.f, -0.f);
+    __m256 bounds[4][kBins];
+    int count[4][kBins];
+    for(int axis = 0; axis < 4; ++axis)
+      for(int b = 0; b < bins; ++b)
+      {
+        bounds[axis][b] = _mm256_set1_ps(FLT_MAX);
+        count[axis][b] = 0;
+      }
+    for(int i = first; i < end; ++i)
+    {
+      const Ref& ref = m_ref[i];
+      const __m256 r = _mm256_xor_ps(_mm256_loadu_ps((const float*)&ref.m_min), negateMax);
+      int s[4];
+      _mm_storeu_si128((__m128i*)s, Slots(ref.Centroid(), cmin, scale, bins));
+      for(int axis = 0; axis < 4; ++axis)
+      {
+        bounds[axis][s[axis]] = _mm256_min_ps(bounds[axis][s[axis]], r);
+        ++count[axis][s[axis]];
+      }
+    }
+    for(int axis = 0; axis < 4; ++axis)
+      for(int b = 0; b < bins; ++b)
+      {
+        const __m256 bb = _mm256_xor_ps(bounds[axis][b], negateMax);
+        bin[axis][b].m_bounds.m_min.abcd = _mm256_castps256_ps128(bb);
+        bin[axis][b].m_bounds.m_max.abcd = _mm256_extractf128_ps(bb, 1);
+        bin[axis][b].m_count = count[axis][b];
+      }
+  }
+
+  void Leaf(int index, int first, int end)
+  {
+    m_node[index].m_first = first;
+    m_node[index].m_count = end - first;
+  }
+
+  void Build(int index, int first, int end, int threads)
+  {
+    const int count = end - first;
+    Node& node = m_node[index];
+    if(count <= 2)
+    {
+      Leaf(index, first, end);
+      return;
+    }
+
+    const bool parallel = count >= kParallelBins && threads > 1;
+    AABT cmin, cmax;
+    if(parallel)
+    {
+      std::vector<AABT> partialMin(threads), partialMax(threads);
+      ParallelFor(threads, [&](int t, int threads)
+      {
+        CentroidBounds(first + (int64_t)count * t / threads, first + (int64_t)count * (t + 1) / threads, &partialMin[t], &partialMax[t]);
+      });
+      cmin = partialMin[0];
+      cmax = partialMax[0];
+      for(int t = 1; t < threads; ++t)
+      {
+        cmin.abcd = _mm_min_ps(cmin.abcd, partialMin[t].abcd);
+        cmax.abcd = _mm_max_ps(cmax.abcd, partialMax[t].abcd);
+      }
+    }
+    else
+      CentroidBounds(first, end, &cmin, &cmax);
+    // a small node gets fewer bins, since the sweep over them costs as much as the binning
+    const int bins = std::min(kBins, std::max(4, count / 4));
+    AABT scale;
+    scale.abcd = _mm_div_ps(_mm_set1_ps(bins * 0.9999f), _mm_max_ps(_mm_sub_ps(cmax.abcd, cmin.abcd), _mm_set1_ps(1e-20f)));
+
+    Bin bin[4][kBins];
+    if(parallel)
+    {
+      std::vector<Bin> partial(threads * 4 * kBins);
+      ParallelFor(threads, [&](int t, int threads)
+      {
+        Fill(first + (int64_t)count * t / threads, first + (int64_t)count * (t + 1) / threads, cmin, scale, bins, (Bin(*)[kBins])&partial[t * 4 * kBins]);
+      });
+      for(int axis = 0; axis < 4; ++axis)
+        for(int b = 0; b < bins; ++b)
+        {
+          bin[axis][b] = partial[axis * kBins + b];
+          for(int t = 1; t < threads; ++t)
+          {
+            bin[axis][b].m_bounds.Grow(partial[(t * 4 + axis) * kBins + b].m_bounds);
+            bin[axis][b].m_count += partial[(t * 4 + axis) * kBins + b].m_count;
+          }
+        }
+    }
+    else
+      Fill(first, end, cmin, scale, bins, bin);
+
+    // sweep each axis from both ends for the cheapest split
+    const float upArea = UpArea(node.m_min);
+    const float octahedronArea = OctahedronArea(node.m_min, node.m_max);
+    float bestCost = count * kObjectCost;
+    int bestAxis = -1, bestSplit = 0;
+    Bounds bestLeft, bestRight;
+    for(int axis = 0; axis < 4; ++axis)
+    {
+      Bounds right[kBins];
+      int rightCount[kBins];
+      Bounds r = Bounds::Empty();
+      int n = 0;
+      for(int b = bins - 1; b > 0; --b)
+      {
+        r.Grow(bin[axis][b].m_bounds);
+        n += bin[axis][b].m_count;
+        right[b] = r;
+        rightCount[b] = n;
+      }
+      Bounds l = Bounds::Empty();
+      n = 0;
+      for(int split = 1; split < bins; ++split)
+      {
+        l.Grow(bin[axis][split - 1].m_bounds);
+        n += bin[axis][split - 1].m_count;
+        if(n == 0 || rightCount[split] == 0)
+          continue;
+        float cost = 2.f * kUpCost;
+        cost += (UpArea(l.m_min) / upArea) * kDownCost + (OctahedronArea(l.m_min, l.m_max) / octahedronArea) * n * kObjectCost;
+        cost += (UpArea(right[split].m_min) / upArea) * kDownCost + (OctahedronArea(right[split].m_min, right[split].m_max) / octahedronArea) * rightCount[split] * kObjectCost;
+        if(cost < bestCost)
+        {
+          bestCost = cost;
+          bestAxis = axis;
+          bestSplit = split;
+          bestLeft = l;
+          bestRight = right[split];
+        }
+      }
+    }
+
+    int middle;
+    if(bestAxis >= 0)
+    {
+      middle = std::partition(m_ref.begin() + first, m_ref.begin() + end, [&](const Ref& ref)
+      {
+        int s[4];
+        _mm_storeu_si128((__m128i*)s, Slots(ref.Centroid(), cmin, scale, bins));
+        return s[bestAxis] < bestSplit;
+      }) - m_ref.begin();
+    }
+    else if(count <= kLeafMax)
+    {
+      Leaf(index, first, end);
+      return;
+    }
+    else
+    {
+      // no split beats a leaf, or every centroid is in the same place, but the leaf is
+      // too big: split at the median of the longest centroid axis
+      const float e[4] = {cmax.a - cmin.a, cmax.b - cmin.b, cmax.c - cmin.c, cmax.d - cmin.d};
+      const int axis = std::max_element(e, e + 4) - e;
+      middle = first + count / 2;
+      std::nth_element(m_ref.begin() + first, m_ref.begin() + middle, m_ref.begin() + end, [&](const Ref& a, const Ref& b)
+      {
+        float4 ca, cb;
+        ca.abcd = a.Centroid();
+        cb.abcd = b.Centroid();
+        return ((const float*)&ca)[axis] < ((const float*)&cb)[axis];
+      });
+      bestLeft = bestRight = Bounds::Empty();
+      for(int i = first; i < middle; ++i)
+        bestLeft.Grow(m_ref[i].m_min, m_ref[i].m_max);
+      for(int i = middle; i < end; ++i)
+        bestRight.Grow(m_ref[i].m_min, m_ref[i].m_max);
+    }
+
+    const int child = m_nodes.fetch_add(2);
+    node.m_first = child;
+    node.m_count = 0;
+    m_node[child].m_min = bestLeft.m_min;
+    m_node[child].m_max = bestLeft.m_max;
+    m_node[child + 1].m_min = bestRight.m_min;
+    m_node[child + 1].m_max = bestRight.m_max;
+
+    if(std::min(middle - first, end - middle) >= kTaskMin && threads > 1)
+    {
+      // SAH splits are often lopsided, so each side gets threads in proportion to its objects
+      const int left = std::min(threads - 1, std::max(1, (int)((int64_t)threads * (middle - first) / count)));
+      std::thread task([=]()
+      {
+        Build(child, first, middle, left);
+      });
+      Build(child + 1, middle, end, threads - left);
+      task.join();
+    }
+    else
+    {
+      Build(child, first, middle, threads);
+      Build(child + 1, middle, end, threads);
+    }
+  }
+};
+
+int main(int argc, char* argv[])
+{
+  Mesh mesh;
+  mesh.Generate(100, 1.0f);
+
+  const int kTests = 1000;
+
+  const int kObjects = 10000000;
+  std::vector<Object> objects(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    objects[o].m_mesh = &mesh;
+    objects[o].m_position.x = random(-50.f, 50.f);
+    objects[o].m_position.y = random(-50.f, 50.f);
+    objects[o].m_position.z = random(-50.f, 50.f);
+  }
+
+  std::vector<AABT> aabtMin(kObjects);
+  std::vector<AABT> aabtMax(kObjects);
+  for(int a = 0; a < kObjects; ++a)
+    objects[a].CalculateAABT(&aabtMin[a], &aabtMax[a]);
+
+  int expected = 0;
+  {
+    const int kScans = 10; // a linear scan per query is too slow to do kTests of them
+    const WallClock clock;
+    for(int test = 0; test < kScans; ++test)
+    {
+      const AABT probeMin = aabtMin[test];
+      const AABT probeMax = aabtMax[test];
+      for(int t = 0; t < kObjects; ++t)
+      {
+        const AABT targetMin = aabtMin[t];
+        if(targetMin <= probeMax)
+        {
+          const AABT targetMax = aabtMax[t];
+          if(probeMin <= targetMax)
+            ++expected;
+        }
+      }
+    }
+    const float seconds = clock.seconds();
+    printf("AABO SIMD linear scan reported %d intersections in %f seconds for %d queries\n", expected, seconds, kScans);
+  }
+
+  const int cores = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<int> threads;
+  threads.push_back(1);
+  if(cores > 1)
+    threads.push_back(cores);
+  for(int t = 0; t < threads.size(); ++t)
+  {
+    const WallClock build;
+    const BVH bvh(aabtMin, aabtMax, threads[t]);
+    const float buildSeconds = build.seconds();
+
+    std::vector<int> stack;
+    int check = 0;
+    for(int test = 0; test < 10; ++test)
+      check += bvh.Intersections(aabtMin[test], aabtMax[test], &stack);
+
+    const WallClock query;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+      intersections += bvh.Intersections(aabtMin[test], aabtMax[test], &stack);
+    const float querySeconds = query.seconds();
+
+    printf("BVH, %d threads, %d nodes, depth %d, built in %f seconds%s\n", threads[t], (int)bvh.m_node.size(), bvh.Depth(), buildSeconds,
+           check == expected ? "" : ", DISAGREES WITH THE LINEAR SCAN");
+    printf("  reported %d intersections in %f seconds for %d queries\n", intersections, querySeconds, kTests);
+  }
+  return 0;
+}
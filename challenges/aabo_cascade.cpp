@@ -0,0 +1,667 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include <chrono>
+#include <immintrin.h>
+
+struct Clock
+{
+  const clock_t m_start;
+  Clock() : m_start(clock())
+  {
+  }
+  float seconds() const
+  {
+    const clock_t end = clock();
+    const float seconds = ((float)(end - m_start)) / CLOCKS_PER_SEC;
+    return seconds;
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+float3 min(const float3 a, const float3 b)
+{
+  float3 c = {std::min(a.x,b.x), std::min(a.y,b.y), std::min(a.z,b.z)};
+  return c;
+}
+
+float3 max(const float3 a, const float3 b)
+{
+  float3 c = {std::max(a.x,b.x), std::max(a.y,b.y), std::max(a.z,b.z)};
+  return c;
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABB(float3* mini, float3* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyz;
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      *mini = min(*mini, xyz);
+      *maxi = max(*maxi, xyz);
+    }
+  }
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+float3 operator-(const float3 a, const float3 b)
+{
+  float3 c = {a.x-b.x, a.y-b.y, a.z-b.z};
+  return c;
+}
+
+float3 operator-(const float3 a)
+{
+  float3 c = {-a.x, -a.y, -a.z};
+  return c;
+}
+
+float3 operator*(const float3 a, const float b)
+{
+  float3 c = {a.x*b, a.y*b, a.z*b};
+  return c;
+}
+
+float3 cross(const float3 a, const float3 b)
+{
+  float3 c = {a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x};
+  return c;
+}
+
+typedef float4 BoundingSphere;
+
+void CalculateBoundingSphere(const Object& object, BoundingSphere* sphere)
+{
+  float3 mini, maxi;
+  object.CalculateAABB(&mini, &maxi);
+  const float3 center = (mini + maxi) * 0.5f;
+  float maxRadius = 0.f;
+  for(int p = 0; p < object.m_mesh->m_point.size(); ++p)
+    maxRadius = std::max(maxRadius, length(object.m_position + object.m_mesh->m_point[p] - center));
+  sphere->a = center.x;
+  sphere->b = center.y;
+  sphere->c = center.z;
+  sphere->d = maxRadius;
+}
+
+// The convex hull of a set of points, which is all GJK needs to know about it.
+struct PointSet
+{
+  const float3* m_point;
+  int m_points;
+  float3 m_offset;
+
+  PointSet(const Object& object) : m_point(object.m_mesh->m_point.data()), m_points(object.m_mesh->m_point.size()), m_offset(object.m_position)
+  {
+  }
+  PointSet(const float3* point, int points, const float3 offset) : m_point(point), m_points(points), m_offset(offset)
+  {
+  }
+
+  float3 Support(const float3 direction) const
+  {
+    int best = 0;
+    float bestDot = dot(m_point[0], direction);
+    for(int p = 1; p < m_points; ++p)
+    {
+      const float d = dot(m_point[p], direction);
+      if(d > bestDot)
+      {
+        bestDot = d;
+        best = p;
+      }
+    }
+    return m_point[best] + m_offset;
+  }
+};
+
+// GJK, as a yes/no test: do the convex hulls of two point sets overlap? It searches the
+// Minkowski difference A-B for a simplex that contains the origin, keeping only the feature
+// of the simplex nearest the origin at each step. The newest point is always last.
+struct Simplex
+{
+  float3 m_point[4];
+  int m_points;
+};
+
+bool Line(Simplex* s, float3* direction)
+{
+  const float3 a = s->m_point[1];
+  const float3 ab = s->m_point[0] - a;
+  const float3 ao = -a;
+  if(dot(ab, ao) > 0.f)
+    *direction = cross(cross(ab, ao), ab);
+  else
+  {
+    s->m_point[0] = a;
+    s->m_points = 1;
+    *direction = ao;
+  }
+  return false;
+}
+
+bool Triangle(Simplex* s, float3* direction)
+{
+  const float3 c = s->m_point[0], b = s->m_point[1], a = s->m_point[2];
+  const float3 ab = b - a, ac = c - a, ao = -a;
+  const float3 abc = cross(ab, ac);
+  if(dot(cross(abc, ac), ao) > 0.f)
+  {
+    if(dot(ac, ao) > 0.f)
+    {
+      s->m_point[1] = a;
+      s->m_points = 2;
+      *direction = cross(cross(ac, ao), ac);
+      return false;
+    }
+    s->m_point[0] = b;
+    s->m_point[1] = a;
+    s->m_points = 2;
+    return Line(s, direction);
+  }
+  if(dot(cross(ab, abc), ao) > 0.f)
+  {
+    s->m_point[0] = b;
+    s->m_point[1] = a;
+    s->m_points = 2;
+    return Line(s, direction);
+  }
+  if(dot(abc, ao) > 0.f)
+    *direction = abc;
+  else
+  {
+    s->m_point[0] = b;
+    s->m_point[1] = c;
+    *direction = -abc;
+  }
+  return false;
+}
+
+// The normal of face abc, flipped if need be to point away from the simplex's fourth point.
+float3 Outward(const float3 a, const float3 b, const float3 c, const float3 away)
+{
+  const float3 n = cross(b - a, c - a);
+  return dot(n, away - a) > 0.f ? -n : n;
+}
+
+bool Tetrahedron(Simplex* s, float3* direction)
+{
+  const float3 d = s->m_point[0], c = s->m_point[1], b = s->m_point[2], a = s->m_point[3];
+  const float3 ao = -a;
+  const float3 face[3][3] = {{c, b, a}, {d, c, a}, {b, d, a}};
+  const float3 opposite[3] = {d, b, c};
+  for(int f = 0; f < 3; ++f)
+    if(dot(Outward(a, face[f][0], face[f][1], opposite[f]), ao) > 0.f)
+    {
+      s->m_point[0] = face[f][0];
+      s->m_point[1] = face[f][1];
+      s->m_point[2] = a;
+      s->m_points = 3;
+      return Triangle(s, direction);
+    }
+  return true;
+}
+
+// Touching and numerically degenerate cases run out of iterations and answer yes, which
+// errs the same way a bounding volume does.
+bool Overlap(const PointSet& a, const PointSet& b)
+{
+  const float3 x = {1.f, 0.f, 0.f};
+  Simplex s;
+  s.m_point[0] = a.Support(x) - b.Support(-x);
+  s.m_points = 1;
+  float3 direction = -s.m_point[0];
+  for(int iteration = 0; iteration < 64; ++iteration)
+  {
+    if(dot(direction, direction) < 1e-12f)
+      return true;
+    const float3 p = a.Support(direction) - b.Support(-direction);
+    if(dot(p, direction) < 0.f)
+      return false;
+    s.m_point[s.m_points++] = p;
+    const bool contains = s.m_points == 2 ? Line(&s, &direction)
+                        : s.m_points == 3 ? Triangle(&s, &direction)
+                        : Tetrahedron(&s, &direction);
+    if(contains)
+      return true;
+  }
+  return true;
+}
+
+enum Stage
+{
+  kUp,     // up tetrahedron: targetMin <= probeMax
+  kDown,   // down tetrahedron, which with the up one makes the AABO
+  kSphere, // bounding spheres
+  kExact,  // GJK on the convex hulls of the meshes
+  kStages
+};
+
+const char* const kStageName[] = { "up tetrahedron", "down tetrahedron", "sphere", "exact hull" };
+
+// The columns every stage reads, each stage only its own.
+struct Scene
+{
+  const std::vector<Object>& m_objects;
+  std::vector<AABT> m_aabtMin;
+  std::vector<AABT> m_aabtMax;
+  std::vector<float> m_sphereX;
+  std::vector<float> m_sphereY;
+  std::vector<float> m_sphereZ;
+  std::vector<float> m_sphereR;
+
+  Scene(const std::vector<Object>& objects)
+  : m_objects(objects), m_aabtMin(objects.size()), m_aabtMax(objects.size())
+  , m_sphereX(objects.size()), m_sphereY(objects.size()), m_sphereZ(objects.size()), m_sphereR(objects.size())
+  {
+    for(int o = 0; o < objects.size(); ++o)
+    {
+      objects[o].CalculateAABT(&m_aabtMin[o], &m_aabtMax[o]);
+      BoundingSphere sphere;
+      CalculateBoundingSphere(objects[o], &sphere);
+      m_sphereX[o] = sphere.a;
+      m_sphereY[o] = sphere.b;
+      m_sphereZ[o] = sphere.c;
+      m_sphereR[o] = sphere.d;
+    }
+  }
+
+  int Objects() const
+  {
+    return m_objects.size();
+  }
+};
+
+struct Query
+{
+  AABT m_min;
+  AABT m_max;
+  BoundingSphere m_sphere;
+  PointSet m_hull;
+
+  Query(const Scene& scene, int object)
+  : m_min(scene.m_aabtMin[object]), m_max(scene.m_aabtMax[object]), m_hull(scene.m_objects[object])
+  {
+    m_sphere.a = scene.m_sphereX[object];
+    m_sphere.b = scene.m_sphereY[object];
+    m_sphere.c = scene.m_sphereZ[object];
+    m_sphere.d = scene.m_sphereR[object];
+  }
+};
+
+// Runs one stage over a batch of survivors and writes out the ones that pass it. The write
+// always happens and the count advances by 0 or 1, so the cheap stages never branch.
+int Filter(Stage stage, const Scene& scene, const Query& query, const int* in, int n, int* out)
+{
+  int passed = 0;
+  switch(stage)
+  {
+  case kUp:
+    for(int i = 0; i < n; ++i)
+    {
+      out[passed] = in[i];
+      passed += scene.m_aabtMin[in[i]] <= query.m_max;
+    }
+    break;
+  case kDown:
+    for(int i = 0; i < n; ++i)
+    {
+      out[passed] = in[i];
+      passed += query.m_min <= scene.m_aabtMax[in[i]];
+    }
+    break;
+  case kSphere:
+    for(int i = 0; i < n; ++i)
+    {
+      const int o = in[i];
+      const float dx = scene.m_sphereX[o] - query.m_sphere.a;
+      const float dy = scene.m_sphereY[o] - query.m_sphere.b;
+      const float dz = scene.m_sphereZ[o] - query.m_sphere.c;
+      const float r = scene.m_sphereR[o] + query.m_sphere.d;
+      out[passed] = o;
+      passed += dx*dx + dy*dy + dz*dz <= r*r;
+    }
+    break;
+  default:
+    for(int i = 0; i < n; ++i)
+      if(Overlap(query.m_hull, PointSet(scene.m_objects[in[i]])))
+        out[passed++] = in[i];
+  }
+  return passed;
+}
+
+struct StageStats
+{
+  uint64_t m_in;
+  uint64_t m_out;
+  double m_seconds;
+};
+
+// Later stages see a handful of objects per batch, which takes less time than reading the
+// steady clock does, so stages are timed with the time stamp counter. Its rate is measured
+// against the steady clock once, and the cost of reading it is taken off every interval.
+struct Ticks
+{
+  double m_secondsPerTick;
+  uint64_t m_overhead;
+
+  Ticks()
+  {
+    m_overhead = ~0ull;
+    for(int i = 0; i < 1000; ++i)
+    {
+      const uint64_t start = __rdtsc();
+      m_overhead = std::min<uint64_t>(m_overhead, __rdtsc() - start);
+    }
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const uint64_t ticks = __rdtsc();
+    while(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(20))
+      ;
+    m_secondsPerTick = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / (__rdtsc() - ticks);
+  }
+
+  double Seconds(uint64_t start, uint64_t end) const
+  {
+    return (end - start > m_overhead ? end - start - m_overhead : 0) * m_secondsPerTick;
+  }
+};
+
+const Ticks ticks;
+
+// A sequence of stages, each run over the compacted survivors of the one before, a batch
+// of objects at a time so the survivor lists stay in L1. Any order is correct, since every
+// stage is conservative, but the order decides how much work is done.
+class Cascade
+{
+public:
+  static const int kBatch = 2048;
+
+  Cascade(const std::vector<Stage>& order) : m_order(order), m_stats(order.size())
+  {
+    for(int s = 0; s < m_stats.size(); ++s)
+    {
+      m_stats[s].m_in = m_stats[s].m_out = 0;
+      m_stats[s].m_seconds = 0.0;
+    }
+  }
+
+  // Objects [first, end) that pass every stage.
+  int Intersections(const Scene& scene, const Query& query, int first, int end)
+  {
+    int intersections = 0;
+    int buffer[2][kBatch];
+    for(int batch = first; batch < end; batch += kBatch)
+    {
+      int n = std::min(kBatch, end - batch);
+      for(int i = 0; i < n; ++i)
+        buffer[0][i] = batch + i;
+      for(int s = 0; s < m_order.size() && n; ++s)
+      {
+        const uint64_t start = __rdtsc();
+        const int passed = Filter(m_order[s], scene, query, buffer[s & 1], n, buffer[~s & 1]);
+        m_stats[s].m_seconds += ticks.Seconds(start, __rdtsc());
+        m_stats[s].m_in += n;
+        m_stats[s].m_out += passed;
+        n = passed;
+      }
+      intersections += n;
+    }
+    return intersections;
+  }
+
+  // Builds an order greedily from a sample: at each position, every remaining stage is tried
+  // on what survives the stages already chosen, and the one with the least cost per object
+  // divided by the fraction of objects it removes goes next. That ratio is the classic rule
+  // for ordering independent filters, and measuring it on the survivors rather than on
+  // everything accounts for stages that mostly reject the same objects.
+  static std::vector<Stage> Calibrate(const Scene& scene, const std::vector<Query>& sample, int objects, std::vector<Stage> remaining)
+  {
+    std::vector<Stage> order;
+    printf("%19s | %9s | %9s | %8s | %9s\n", "calibration", "objects", "pass", "ns per", "ns per");
+    printf("%19s | %9s | %9s | %8s | %9s\n", "", "in", "rate", "object", "reject");
+    printf("--------------------------------------------------------------------\n");
+    while(!remaining.empty())
+    {
+      int best = 0;
+      double bestRank = 0.0;
+      for(int r = 0; r < remaining.size(); ++r)
+      {
+        std::vector<Stage> trial = order;
+        trial.push_back(remaining[r]);
+        Cascade cascade(trial);
+        for(int q = 0; q < sample.size(); ++q)
+          cascade.Intersections(scene, sample[q], 0, objects);
+        const StageStats& s = cascade.m_stats.back();
+        const double cost = s.m_in ? s.m_seconds / s.m_in : 0.0;
+        const double pass = s.m_in ? (double)s.m_out / s.m_in : 1.0;
+        const double rank = cost / std::max(1.0 - pass, 1e-6);
+        printf("%19s | %9llu | %8.4f%% | %8.2f | %9.2f\n", kStageName[remaining[r]], (unsigned long long)s.m_in, 100.0 * pass, cost * 1e9, rank * 1e9);
+        if(r == 0 || rank < bestRank)
+        {
+          best = r;
+          bestRank = rank;
+        }
+      }
+      printf("%19s -> %s\n", "", kStageName[remaining[best]]);
+      order.push_back(remaining[best]);
+      remaining.erase(remaining.begin() + best);
+    }
+    printf("\n");
+    return order;
+  }
+
+  void Print(const char* name) const
+  {
+    printf("%s\n", name);
+    printf("%19s | %11s | %9s | %9s | %8s | %7s\n", "stage", "in", "out", "pass", "ns per", "seconds");
+    printf("--------------------------------------------------------------------------\n");
+    for(int s = 0; s < m_order.size(); ++s)
+    {
+      const StageStats& stats = m_stats[s];
+      printf("%19s | %11llu | %9llu | %8.4f%% | %8.2f | %7.4f\n", kStageName[m_order[s]],
+             (unsigned long long)stats.m_in, (unsigned long long)stats.m_out,
+             stats.m_in ? 100.0 * stats.m_out / stats.m_in : 0.0,
+             stats.m_in ? 1e9 * stats.m_seconds / stats.m_in : 0.0, stats.m_seconds);
+    }
+  }
+
+private:
+  std::vector<Stage> m_order;
+  std::vector<StageStats> m_stats;
+};
+
+int main(int argc, char* argv[])
+{
+  const int kMeshes = 100;
+  Mesh mesh[kMeshes];
+  for(int m = 0; m < kMeshes; ++m)
+    mesh[m].Generate(50, 1.f);
+
+  const int kTests = 100;
+  const int kCalibrationTests = 4;
+  const int kCalibrationObjects = 1000000; // enough that the columns come from memory, as in the real queries
+
+  const int kObjects = 10000000;
+  std::vector<Object> objects(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    objects[o].m_mesh = &mesh[rand() % kMeshes];
+    objects[o].m_position.x = random(-50.f, 50.f);
+    objects[o].m_position.y = random(-50.f, 50.f);
+    objects[o].m_position.z = random(-50.f, 50.f);
+  }
+  const Scene scene(objects);
+
+  std::vector<Query> queries;
+  for(int test = 0; test < kTests; ++test)
+    queries.push_back(Query(scene, test));
+
+  {
+    const Clock clock;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+    {
+      const AABT probeMin = queries[test].m_min;
+      const AABT probeMax = queries[test].m_max;
+      for(int t = 0; t < kObjects; ++t)
+      {
+        const AABT targetMin = scene.m_aabtMin[t];
+        if(targetMin <= probeMax)
+        {
+          const AABT targetMax = scene.m_aabtMax[t];
+          if(probeMin <= targetMax)
+            intersections += Overlap(queries[test].m_hull, PointSet(objects[t]));
+        }
+      }
+    }
+    const float seconds = clock.seconds();
+    printf("AABO loop, then exact, reported %d intersections in %f seconds\n\n", intersections, seconds);
+  }
+
+  // calibrated on queries that aren't among the ones timed
+  std::vector<Query> sample;
+  for(int test = 0; test < kCalibrationTests; ++test)
+    sample.push_back(Query(scene, kTests + test));
+  std::vector<Stage> all;
+  for(int s = 0; s < kStages; ++s)
+    all.push_back((Stage)s);
+  const std::vector<Stage> calibrated = Cascade::Calibrate(scene, sample, kCalibrationObjects, all);
+
+  const Stage aabo[] = {kUp, kDown, kExact};
+  const Stage withSphere[] = {kUp, kDown, kSphere, kExact};
+  const Stage sphereFirst[] = {kSphere, kUp, kDown, kExact};
+  struct Run
+  {
+    const char* m_name;
+    std::vector<Stage> m_order;
+  };
+  const Run runs[] =
+  {
+    {"up, down, exact", std::vector<Stage>(aabo, aabo + 3)},
+    {"up, down, sphere, exact", std::vector<Stage>(withSphere, withSphere + 4)},
+    {"sphere, up, down, exact", std::vector<Stage>(sphereFirst, sphereFirst + 4)},
+    {"calibrated", calibrated},
+  };
+  for(int r = 0; r < sizeof(runs) / sizeof(runs[0]); ++r)
+  {
+    Cascade cascade(runs[r].m_order);
+    const Clock clock;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+      intersections += cascade.Intersections(scene, queries[test], 0, kObjects);
+    const float seconds = clock.seconds();
+
+    char name[128];
+    snprintf(name, sizeof(name), "Cascade %s reported %d intersections in %f seconds", runs[r].m_name, intersections, seconds);
+    cascade.Print(name);
+    printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,396 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <stdint.h>
+#include <float.h>
+#include <math.h>
+#include <immintrin.h>
+
+// Readers and the writer run at once, so they are timed in wall time, not in the CPU time
+// clock() would add up across the threads.
+struct WallClock
+{
+  const std::chrono::steady_clock::time_point m_start;
+  WallClock() : m_start(std::chrono::steady_clock::now())
+  {
+  }
+  float seconds() const
+  {
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    return std::chrono::duration<float>(end - m_start).count();
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+// One copy of the columns, holding the objects as they were at the end of one frame.
+struct Generation
+{
+  std::vector<AABT> m_aabtMin;
+  std::vector<AABT> m_aabtMax;
+  std::atomic<int> m_frame; // read back by readers only to check that nothing reused it under them
+  uint64_t m_retired;       // the first epoch in which no reader could still find it; writer only
+};
+
+// A reader's announcement of the epoch it started reading in, on a line of its own so that
+// readers never write to the same line as each other.
+struct alignas(64) ReaderSlot
+{
+  std::atomic<uint64_t> m_epoch;
+};
+
+const uint64_t kIdle = ~0ull;
+
+// Readers query whichever generation is current when they start, for as long as they like,
+// while a single writer fills in the next one. Switching over is an atomic store of the
+// current pointer and a step of the epoch. A generation the writer wants back is free once
+// every reader is idle or started in an epoch since it was retired. A reader only ever does
+// two stores and a load of its own, so the query path takes no lock, and there are never
+// more than kGenerations copies of the columns: the current one, one that readers may still
+// be in, and the one being written. If readers hold on to that second one, the writer waits.
+class Snapshots
+{
+public:
+  static const int kGenerations = 3;
+  static const int kMaxReaders = 64;
+
+  Snapshots(int objects) : m_epoch(1), m_current(0), m_stalls(0)
+  {
+    for(int g = 0; g < kGenerations; ++g)
+    {
+      m_generation[g].m_aabtMin.resize(objects);
+      m_generation[g].m_aabtMax.resize(objects);
+      m_generation[g].m_frame = -1;
+      m_generation[g].m_retired = 0;
+    }
+    for(int r = 0; r < kMaxReaders; ++r)
+      m_reader[r].m_epoch = kIdle;
+  }
+
+  // Reader side. The epoch is announced before the current pointer is read, so a writer
+  // that sees the announcement knows which generations this reader might be in.
+  const Generation* Pin(int reader)
+  {
+    m_reader[reader].m_epoch.store(m_epoch.load());
+    return m_current.load();
+  }
+
+  void Unpin(int reader)
+  {
+    m_reader[reader].m_epoch.store(kIdle, std::memory_order_release);
+  }
+
+  // Writer side: a generation that is neither current nor in use, to fill in.
+  Generation* Acquire()
+  {
+    for(;;)
+    {
+      uint64_t oldest = kIdle;
+      for(int r = 0; r < kMaxReaders; ++r)
+        oldest = std::min<uint64_t>(oldest, m_reader[r].m_epoch.load());
+      const Generation* current = m_current.load(std::memory_order_relaxed);
+      for(int g = 0; g < kGenerations; ++g)
+        if(&m_generation[g] != current && m_generation[g].m_retired <= oldest)
+          return &m_generation[g];
+      ++m_stalls;
+      std::this_thread::yield();
+    }
+  }
+
+  void Publish(Generation* generation)
+  {
+    Generation* previous = m_current.exchange(generation);
+    if(previous)
+      previous->m_retired = m_epoch.fetch_add(1) + 1;
+  }
+
+  uint64_t Stalls() const
+  {
+    return m_stalls;
+  }
+
+  size_t Bytes() const
+  {
+    return kGenerations * 2 * m_generation[0].m_aabtMin.size() * sizeof(AABT);
+  }
+
+private:
+  std::atomic<uint64_t> m_epoch;
+  std::atomic<Generation*> m_current;
+  Generation m_generation[kGenerations];
+  ReaderSlot m_reader[kMaxReaders];
+  uint64_t m_stalls;
+};
+
+// The simulation: every object drifts at its own velocity, so its bounds at any frame are
+// its mesh's bounds moved by its position then, and anyone can work out what they should be.
+struct Simulation
+{
+  AABT m_meshMin;
+  AABT m_meshMax;
+  std::vector<float3> m_start;
+  std::vector<float3> m_velocity;
+
+  void Bounds(int object, int frame, AABT* mini, AABT* maxi) const
+  {
+    const float3 position = {m_start[object].x + m_velocity[object].x * frame,
+                             m_start[object].y + m_velocity[object].y * frame,
+                             m_start[object].z + m_velocity[object].z * frame};
+    const float4 offset = xyzToAbcd(position);
+    mini->abcd = _mm_add_ps(m_meshMin.abcd, offset.abcd);
+    maxi->abcd = _mm_add_ps(m_meshMax.abcd, offset.abcd);
+  }
+
+  void Step(int frame, Generation* generation) const
+  {
+    for(int o = 0; o < m_start.size(); ++o)
+      Bounds(o, frame, &generation->m_aabtMin[o], &generation->m_aabtMax[o]);
+    generation->m_frame.store(frame, std::memory_order_relaxed);
+  }
+};
+
+int Intersections(const Generation& generation, const AABT probeMin, const AABT probeMax)
+{
+  int intersections = 0;
+  for(int t = 0; t < generation.m_aabtMin.size(); ++t)
+  {
+    const AABT targetMin = generation.m_aabtMin[t];
+    if(targetMin <= probeMax)
+    {
+      const AABT targetMax = generation.m_aabtMax[t];
+      if(probeMin <= targetMax)
+        ++intersections;
+    }
+  }
+  return intersections;
+}
+
+// Whether a generation still holds exactly one frame: a sample of its objects must have the
+// bounds the simulation gives for that frame, and the frame must not have changed meanwhile.
+bool Consistent(const Simulation& simulation, const Generation& generation, int frame, int seed)
+{
+  const int kSamples = 16;
+  const int objects = generation.m_aabtMin.size();
+  for(int s = 0; s < kSamples; ++s)
+  {
+    const int o = (int)(((uint64_t)seed * 7919 + (uint64_t)s * 104729) % objects);
+    AABT mini, maxi;
+    simulation.Bounds(o, frame, &mini, &maxi);
+    const AABT gotMin = generation.m_aabtMin[o];
+    const AABT gotMax = generation.m_aabtMax[o];
+    if(!(mini <= gotMin && gotMin <= mini && maxi <= gotMax && gotMax <= maxi))
+      return false;
+  }
+  return generation.m_frame.load(std::memory_order_relaxed) == frame;
+}
+
+int main(int argc, char* argv[])
+{
+  Mesh mesh;
+  mesh.Generate(100, 1.0f);
+  Object origin;
+  origin.m_mesh = &mesh;
+  origin.m_position.x = origin.m_position.y = origin.m_position.z = 0.f;
+
+  const int kObjects = 1000000;
+  const int kFrames = 100;
+  const int kProbes = 100;
+
+  Simulation simulation;
+  origin.CalculateAABT(&simulation.m_meshMin, &simulation.m_meshMax);
+  simulation.m_start.resize(kObjects);
+  simulation.m_velocity.resize(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    simulation.m_start[o].x = random(-50.f, 50.f);
+    simulation.m_start[o].y = random(-50.f, 50.f);
+    simulation.m_start[o].z = random(-50.f, 50.f);
+    simulation.m_velocity[o].x = random(-0.1f, 0.1f);
+    simulation.m_velocity[o].y = random(-0.1f, 0.1f);
+    simulation.m_velocity[o].z = random(-0.1f, 0.1f);
+  }
+
+  Snapshots snapshots(kObjects);
+  {
+    Generation* first = snapshots.Acquire();
+    simulation.Step(0, first);
+    snapshots.Publish(first);
+  }
+
+  {
+    const int kTests = 100;
+    const WallClock clock;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+    {
+      const Generation* generation = snapshots.Pin(0);
+      intersections += Intersections(*generation, generation->m_aabtMin[test % kProbes], generation->m_aabtMax[test % kProbes]);
+      snapshots.Unpin(0);
+    }
+    const float seconds = clock.seconds();
+    printf("Pinned queries with no writer reported %d intersections in %f seconds for %d queries\n", intersections, seconds, kTests);
+  }
+
+  const int cores = std::max(1u, std::thread::hardware_concurrency());
+  const int readers = std::min(Snapshots::kMaxReaders, std::max(2, cores - 1));
+  std::atomic<bool> done(false);
+  std::vector<uint64_t> queries(readers, 0), intersections(readers, 0), inconsistent(readers, 0), frames(readers, 0);
+  std::vector<std::thread> reader;
+  const WallClock clock;
+  for(int r = 0; r < readers; ++r)
+    reader.push_back(std::thread([&, r]()
+    {
+      int lastFrame = -1;
+      for(int q = 0; !done.load(std::memory_order_relaxed); ++q)
+      {
+        const Generation* generation = snapshots.Pin(r);
+        const int frame = generation->m_frame.load(std::memory_order_relaxed);
+        const int probe = (q * readers + r) % kProbes;
+        intersections[r] += Intersections(*generation, generation->m_aabtMin[probe], generation->m_aabtMax[probe]);
+        inconsistent[r] += !Consistent(simulation, *generation, frame, q);
+        snapshots.Unpin(r);
+        ++queries[r];
+        frames[r] += frame != lastFrame;
+        lastFrame = frame;
+      }
+    }));
+
+  float writerSeconds;
+  {
+    const WallClock writer;
+    for(int frame = 1; frame <= kFrames; ++frame)
+    {
+      Generation* next = snapshots.Acquire();
+      simulation.Step(frame, next);
+      snapshots.Publish(next);
+    }
+    writerSeconds = writer.seconds();
+  }
+  done = true;
+  for(int r = 0; r < readers; ++r)
+    reader[r].join();
+  const float seconds = clock.seconds();
+
+  uint64_t totalQueries = 0, totalIntersections = 0, totalInconsistent = 0, totalFrames = 0;
+  for(int r = 0; r < readers; ++r)
+  {
+    totalQueries += queries[r];
+    totalIntersections += intersections[r];
+    totalInconsistent += inconsistent[r];
+    totalFrames += frames[r];
+  }
+  printf("Writer published %d frames in %f seconds, waiting for readers %llu times\n", kFrames, writerSeconds, (unsigned long long)snapshots.Stalls());
+  printf("%d readers ran %llu queries in %f seconds, reporting %llu intersections and seeing %.1f frames each\n", readers,
+         (unsigned long long)totalQueries, seconds, (unsigned long long)totalIntersections, (double)totalFrames / readers);
+  printf("%llu queries ran on an inconsistent snapshot\n", (unsigned long long)totalInconsistent);
+  printf("Columns for %d generations take %.1f MB, %d times one frame's\n", Snapshots::kGenerations, snapshots.Bytes() / (1024.f * 1024.f), Snapshots::kGenerations);
+  return 0;
+}
@@ -0,0 +1,503 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include <immintrin.h>
+
+struct Clock
+{
+  const clock_t m_start;
+  Clock() : m_start(clock())
+  {
+  }
+  float seconds() const
+  {
+    const clock_t end = clock();
+    const float seconds = ((float)(end - m_start)) / CLOCKS_PER_SEC;
+    return seconds;
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+float3 min(const float3 a, const float3 b)
+{
+  float3 c = {std::min(a.x,b.x), std::min(a.y,b.y), std::min(a.z,b.z)};
+  return c;
+}
+
+float3 max(const float3 a, const float3 b)
+{
+  float3 c = {std::max(a.x,b.x), std::max(a.y,b.y), std::max(a.z,b.z)};
+  return c;
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABB(float3* mini, float3* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyz;
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      *mini = min(*mini, xyz);
+      *maxi = max(*maxi, xyz);
+    }
+  }
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+// Pragmatic axes in integers: A=X, B=Y, C=Z, D=-(X+Y+Z). With integer coordinates every one
+// of those is exact, so the bounds are exactly as tight as the vertices, and nothing has to
+// be rounded or converted at build time or at query time.
+union int4
+{
+  __m128i abcd;
+  struct { int32_t a,b,c,d; };
+};
+
+bool operator<=(const int4 a, const int4 b)
+{
+  return _mm_movemask_epi8(_mm_cmpgt_epi32(a.abcd, b.abcd)) == 0;
+}
+
+// Half the bytes of int4, for worlds whose x+y+z fits in 16 bits.
+union short4
+{
+  int64_t abcd;
+  struct { int16_t a,b,c,d; };
+};
+
+bool operator<=(const short4 a, const short4 b)
+{
+  const __m128i x = _mm_cvtsi64_si128(a.abcd);
+  const __m128i y = _mm_cvtsi64_si128(b.abcd);
+  return (_mm_movemask_epi8(_mm_cmpgt_epi16(x, y)) & 0xFF) == 0;
+}
+
+struct int3
+{
+  int x,y,z;
+};
+
+struct IntMesh
+{
+  std::vector<int3> m_point;
+  void Generate(int points, int radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = rand() % (2 * radius + 1) - radius;
+        m_point[p].y = rand() % (2 * radius + 1) - radius;
+        m_point[p].z = rand() % (2 * radius + 1) - radius;
+      } while(m_point[p].x * m_point[p].x + m_point[p].y * m_point[p].y + m_point[p].z * m_point[p].z > radius * radius);
+    }
+  }
+};
+
+// An object in grid-snapped simulation units.
+struct IntObject
+{
+  IntMesh *m_mesh;
+  int3 m_position;
+  void CalculatePragmatic(int4* mini, int4* maxi) const
+  {
+    for(int p = 0; p < m_mesh->m_point.size(); ++p)
+    {
+      const int x = m_position.x + m_mesh->m_point[p].x;
+      const int y = m_position.y + m_mesh->m_point[p].y;
+      const int z = m_position.z + m_mesh->m_point[p].z;
+      const int d = -(x + y + z);
+      if(p == 0)
+      {
+        mini->a = maxi->a = x;
+        mini->b = maxi->b = y;
+        mini->c = maxi->c = z;
+        mini->d = maxi->d = d;
+        continue;
+      }
+      mini->a = std::min(mini->a, x);
+      mini->b = std::min(mini->b, y);
+      mini->c = std::min(mini->c, z);
+      mini->d = std::min(mini->d, d);
+      maxi->a = std::max(maxi->a, x);
+      maxi->b = std::max(maxi->b, y);
+      maxi->c = std::max(maxi->c, z);
+      maxi->d = std::max(maxi->d, d);
+    }
+  }
+};
+
+short4 Narrow(const int4 v)
+{
+  short4 s;
+  s.a = v.a;
+  s.b = v.b;
+  s.c = v.c;
+  s.d = v.d;
+  return s;
+}
+
+float4 Widen(const int4 v)
+{
+  float4 f;
+  f.abcd = _mm_cvtepi32_ps(v.abcd);
+  return f;
+}
+
+// Rounds v/step down, and then corrects it, since the division can round up onto the next
+// integer (-Ofast turns it into a multiply by the reciprocal). q*step is exact in a double.
+int16_t FloorStep(float v, float step)
+{
+  int q = (int)floorf(v / step);
+  while((double)q * step > v)
+    --q;
+  return q;
+}
+
+int16_t CeilStep(float v, float step)
+{
+  int q = (int)ceilf(v / step);
+  while((double)q * step < v)
+    ++q;
+  return q;
+}
+
+// Bounds that start out as floats, in world units, quantized onto a grid of step units.
+// The min side is rounded down and the max side up, lane by lane, so the quantized AABO
+// always contains the float one and a query can only accept more, never miss anything.
+void Quantize(const float4 mini, const float4 maxi, float step, short4* qmin, short4* qmax)
+{
+  qmin->a = FloorStep(mini.a, step);
+  qmin->b = FloorStep(mini.b, step);
+  qmin->c = FloorStep(mini.c, step);
+  qmin->d = FloorStep(mini.d, step);
+  qmax->a = CeilStep(maxi.a, step);
+  qmax->b = CeilStep(maxi.b, step);
+  qmax->c = CeilStep(maxi.c, step);
+  qmax->d = CeilStep(maxi.d, step);
+}
+
+// One bit per object, set if the object's whole up side is <= the query's: the four lane bits
+// of each object are ANDed together and gathered into one bit with pext.
+#if defined(__AVX512F__) && defined(__AVX512BW__) && defined(__BMI2__)
+const int kStep = 16;
+
+unsigned Up(const float4* column, const float4 queryMax)
+{
+  const __m512 query = _mm512_maskz_broadcast_f32x4(0xFFFF, queryMax.abcd);
+  unsigned objects = 0;
+  for(int r = 0; r < 4; ++r)
+  {
+    const unsigned lanes = _mm512_cmp_ps_mask(_mm512_loadu_ps((const float*)&column[r * 4]), query, _CMP_LE_OQ);
+    objects |= _pext_u32(lanes & (lanes >> 1) & (lanes >> 2) & (lanes >> 3), 0x1111) << (r * 4);
+  }
+  return objects;
+}
+
+unsigned Up(const int4* column, const int4 queryMax)
+{
+  const __m512i query = _mm512_maskz_broadcast_i32x4(0xFFFF, queryMax.abcd);
+  unsigned objects = 0;
+  for(int r = 0; r < 4; ++r)
+  {
+    const unsigned lanes = _mm512_cmple_epi32_mask(_mm512_loadu_si512(&column[r * 4]), query);
+    objects |= _pext_u32(lanes & (lanes >> 1) & (lanes >> 2) & (lanes >> 3), 0x1111) << (r * 4);
+  }
+  return objects;
+}
+
+unsigned Up(const short4* column, const short4 queryMax)
+{
+  const __m512i query = _mm512_set1_epi64(queryMax.abcd);
+  unsigned objects = 0;
+  for(int r = 0; r < 2; ++r)
+  {
+    const unsigned lanes = _mm512_cmple_epi16_mask(_mm512_loadu_si512(&column[r * 8]), query);
+    objects |= _pext_u32(lanes & (lanes >> 1) & (lanes >> 2) & (lanes >> 3), 0x11111111) << (r * 8);
+  }
+  return objects;
+}
+#elif defined(__AVX2__) && defined(__BMI2__)
+const int kStep = 8;
+
+unsigned Up(const float4* column, const float4 queryMax)
+{
+  const __m256 query = _mm256_broadcast_ps(&queryMax.abcd);
+  unsigned objects = 0;
+  for(int r = 0; r < 4; ++r)
+  {
+    const unsigned lanes = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps((const float*)&column[r * 2]), query, _CMP_LE_OQ));
+    objects |= _pext_u32(lanes & (lanes >> 1) & (lanes >> 2) & (lanes >> 3), 0x11) << (r * 2);
+  }
+  return objects;
+}
+
+// AVX2 has only a greater-than compare for integers, so these find the lanes that fail.
+unsigned Up(const int4* column, const int4 queryMax)
+{
+  const __m256i query = _mm256_broadcastsi128_si256(queryMax.abcd);
+  unsigned objects = 0;
+  for(int r = 0; r < 4; ++r)
+  {
+    const __m256i fail = _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)&column[r * 2]), query);
+    const unsigned lanes = ~_mm256_movemask_ps(_mm256_castsi256_ps(fail));
+    objects |= _pext_u32(lanes & (lanes >> 1) & (lanes >> 2) & (lanes >> 3), 0x11) << (r * 2);
+  }
+  return objects;
+}
+
+unsigned Up(const short4* column, const short4 queryMax)
+{
+  const __m256i query = _mm256_set1_epi64x(queryMax.abcd);
+  unsigned objects = 0;
+  for(int r = 0; r < 2; ++r)
+  {
+    const __m256i fail = _mm256_cmpgt_epi16(_mm256_loadu_si256((const __m256i*)&column[r * 4]), query);
+    unsigned lanes = ~_mm256_movemask_epi8(fail); // two bits per lane, eight per object
+    lanes &= lanes >> 1;
+    lanes &= lanes >> 2;
+    lanes &= lanes >> 4;
+    objects |= _pext_u32(lanes, 0x01010101) << (r * 4);
+  }
+  return objects;
+}
+#else
+const int kStep = 1;
+
+template<typename V> unsigned Up(const V* column, const V queryMax)
+{
+  return column[0] <= queryMax;
+}
+#endif
+
+// The same kernel for every representation: a wide up test over kStep objects at a time,
+// then the down test of only those that passed, one by one.
+template<typename V> int Intersections(const V* mins, const V* maxs, int objects, const V queryMin, const V queryMax, int* partials)
+{
+  int intersections = 0;
+  int t = 0;
+  for(; t + kStep <= objects; t += kStep)
+  {
+    unsigned passed = Up(mins + t, queryMax);
+    *partials += _mm_popcnt_u32(passed);
+    while(passed)
+    {
+      const int o = t + __builtin_ctz(passed);
+      intersections += queryMin <= maxs[o];
+      passed &= passed - 1;
+    }
+  }
+  for(; t < objects; ++t)
+    if(mins[t] <= queryMax)
+    {
+      ++*partials;
+      intersections += queryMin <= maxs[t];
+    }
+  return intersections;
+}
+
+int main(int argc, char* argv[])
+{
+  // radius 1 in a world 100 across, as in aabo.cpp, but in units of 1/100
+  const int kMeshes = 100;
+  IntMesh mesh[kMeshes];
+  for(int m = 0; m < kMeshes; ++m)
+    mesh[m].Generate(50, 100);
+
+  const int kTests = 100;
+
+  const int kObjects = 10000000;
+  IntObject* objects = new IntObject[kObjects];
+  for(int o = 0; o < kObjects; ++o)
+  {
+    objects[o].m_mesh = &mesh[rand() % kMeshes];
+    objects[o].m_position.x = rand() % 10001 - 5000;
+    objects[o].m_position.y = rand() % 10001 - 5000;
+    objects[o].m_position.z = rand() % 10001 - 5000;
+  }
+
+  // |x+y+z| is at most 3 * 5100 here, well inside 16 bits
+  int4* intMin = new int4[kObjects];
+  int4* intMax = new int4[kObjects];
+  for(int a = 0; a < kObjects; ++a)
+    objects[a].CalculatePragmatic(&intMin[a], &intMax[a]);
+
+  short4* shortMin = new short4[kObjects];
+  short4* shortMax = new short4[kObjects];
+  float4* floatMin = new float4[kObjects];
+  float4* floatMax = new float4[kObjects];
+  for(int a = 0; a < kObjects; ++a)
+  {
+    shortMin[a] = Narrow(intMin[a]);
+    shortMax[a] = Narrow(intMax[a]);
+    floatMin[a] = Widen(intMin[a]);
+    floatMax[a] = Widen(intMax[a]);
+  }
+
+  // the same scene as if its bounds had come out of a float pipeline in world units,
+  // then snapped conservatively onto a grid four units apart
+  const float kStepSize = 4.f;
+  short4* coarseMin = new short4[kObjects];
+  short4* coarseMax = new short4[kObjects];
+  for(int a = 0; a < kObjects; ++a)
+  {
+    float4 worldMin, worldMax;
+    worldMin.abcd = _mm_mul_ps(floatMin[a].abcd, _mm_set1_ps(0.01f));
+    worldMax.abcd = _mm_mul_ps(floatMax[a].abcd, _mm_set1_ps(0.01f));
+    Quantize(worldMin, worldMax, kStepSize * 0.01f, &coarseMin[a], &coarseMax[a]);
+  }
+
+  const char *title = "%28s | %5s | %9s | %7s | %7s\n";
+  printf(title, "Representation", "bytes", "partial", "accepts", "seconds");
+  printf("---------------------------------------------------------------------\n");
+
+  const char *format = "%28s | %5d | %9d | %7d | %3.4f\n";
+
+  {
+    const Clock clock;
+    int partials = 0;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+      intersections += Intersections(floatMin, floatMax, kObjects, floatMin[test], floatMax[test], &partials);
+    const float seconds = clock.seconds();
+    printf(format, "float", (int)sizeof(float4) * 2, partials, intersections, seconds);
+  }
+
+  {
+    const Clock clock;
+    int partials = 0;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+      intersections += Intersections(intMin, intMax, kObjects, intMin[test], intMax[test], &partials);
+    const float seconds = clock.seconds();
+    printf(format, "int32", (int)sizeof(int4) * 2, partials, intersections, seconds);
+  }
+
+  {
+    const Clock clock;
+    int partials = 0;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+      intersections += Intersections(shortMin, shortMax, kObjects, shortMin[test], shortMax[test], &partials);
+    const float seconds = clock.seconds();
+    printf(format, "int16", (int)sizeof(short4) * 2, partials, intersections, seconds);
+  }
+
+  {
+    const Clock clock;
+    int partials = 0;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+      intersections += Intersections(coarseMin, coarseMax, kObjects, coarseMin[test], coarseMax[test], &partials);
+    const float seconds = clock.seconds();
+    printf(format, "int16, from floats, step 4", (int)sizeof(short4) * 2, partials, intersections, seconds);
+  }
+  return 0;
+}
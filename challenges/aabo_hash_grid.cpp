@@ -0,0 +1,553 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <stdint.h>
+#include <assert.h>
+#include <math.h>
+#include <immintrin.h>
+
+// clock() adds up the CPU time of every thread, so the parallel sort would look
+// slower the more threads it used. Wall time is what a frame budget cares about.
+struct WallClock
+{
+  const std::chrono::steady_clock::time_point m_start;
+  WallClock() : m_start(std::chrono::steady_clock::now())
+  {
+  }
+  float seconds() const
+  {
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    return std::chrono::duration<float>(end - m_start).count();
+  }
+};
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+float4 operator+(const float4 a, const float4 b)
+{
+  float4 c;
+  c.abcd = _mm_add_ps(a.abcd,b.abcd);
+  return c;
+}
+
+// Objects are filed under the grid cell that contains their position, so a move is O(1):
+// at worst a swap-remove from one bucket and a push onto another. Each bucket keeps its
+// up and down tetrahedra in separate arrays, and the ordinary 4-compare test runs inside.
+// Cells are hashed into a fixed number of buckets, so the world needn't be bounded, and two
+// cells that land in the same bucket are told apart by the tetrahedron test itself.
+struct HashGrid
+{
+  struct Bucket
+  {
+    std::vector<AABT> m_min;
+    std::vector<AABT> m_max;
+    std::vector<int> m_id;
+  };
+
+  float m_cellSize;
+  float m_reach;              // furthest any object's AABO extends from its position, on X, Y or Z
+  std::vector<Bucket> m_bucket;
+  std::vector<int> m_bucketOf; // per object
+  std::vector<int> m_slotOf;   // per object, index within its bucket
+
+  HashGrid(float cellSize, float reach, int buckets)
+  : m_cellSize(cellSize), m_reach(reach), m_bucket(buckets)
+  {
+    assert(buckets > 0 && (buckets & (buckets - 1)) == 0); // Hash masks with buckets - 1
+  }
+
+  int Cell(float f) const
+  {
+    return (int)floorf(f / m_cellSize);
+  }
+
+  int Hash(int x, int y, int z) const
+  {
+    return ((unsigned)x * 73856093u ^ (unsigned)y * 19349663u ^ (unsigned)z * 83492791u) & (m_bucket.size() - 1);
+  }
+
+  int BucketOf(const float3 position) const
+  {
+    return Hash(Cell(position.x), Cell(position.y), Cell(position.z));
+  }
+
+  // Files every object from scratch, as a parallel scatter. Each thread counts its own range
+  // of objects per bucket, a prefix sum over the threads gives each thread its first slot in
+  // every bucket, and then each thread writes its objects into slots no other thread writes.
+  // Within a bucket, objects stay in the order of their ids.
+  void Rebuild(const std::vector<Object>& objects, const std::vector<AABT>& aabtMin, const std::vector<AABT>& aabtMax, int threads)
+  {
+    const int count = objects.size();
+    const int buckets = m_bucket.size();
+    m_bucketOf.resize(count);
+    m_slotOf.resize(count);
+    std::vector<std::vector<int> > slot(threads, std::vector<int>(buckets, 0));
+    std::vector<std::thread> worker;
+    for(int thread = 0; thread < threads; ++thread)
+      worker.push_back(std::thread([=, &objects, &slot]()
+      {
+        const int first = (int64_t)count * thread / threads;
+        const int end = (int64_t)count * (thread + 1) / threads;
+        for(int o = first; o < end; ++o)
+        {
+          m_bucketOf[o] = BucketOf(objects[o].m_position);
+          ++slot[thread][m_bucketOf[o]];
+        }
+      }));
+    for(int thread = 0; thread < threads; ++thread)
+      worker[thread].join();
+    worker.clear();
+
+    for(int thread = 0; thread < threads; ++thread)
+      worker.push_back(std::thread([=, &slot]()
+      {
+        const int first = (int64_t)buckets * thread / threads;
+        const int end = (int64_t)buckets * (thread + 1) / threads;
+        for(int b = first; b < end; ++b)
+        {
+          int size = 0;
+          for(int t = 0; t < threads; ++t)
+          {
+            const int n = slot[t][b];
+            slot[t][b] = size;
+            size += n;
+          }
+          m_bucket[b].m_min.resize(size);
+          m_bucket[b].m_max.resize(size);
+          m_bucket[b].m_id.resize(size);
+        }
+      }));
+    for(int thread = 0; thread < threads; ++thread)
+      worker[thread].join();
+    worker.clear();
+
+    for(int thread = 0; thread < threads; ++thread)
+      worker.push_back(std::thread([=, &aabtMin, &aabtMax, &slot]()
+      {
+        const int first = (int64_t)count * thread / threads;
+        const int end = (int64_t)count * (thread + 1) / threads;
+        for(int o = first; o < end; ++o)
+        {
+          const int b = m_bucketOf[o];
+          const int s = slot[thread][b]++;
+          m_slotOf[o] = s;
+          m_bucket[b].m_min[s] = aabtMin[o];
+          m_bucket[b].m_max[s] = aabtMax[o];
+          m_bucket[b].m_id[s] = o;
+        }
+      }));
+    for(int thread = 0; thread < threads; ++thread)
+      worker[thread].join();
+  }
+
+  void Move(int id, const float3 position, const AABT mini, const AABT maxi)
+  {
+    const int from = m_bucketOf[id];
+    const int to = BucketOf(position);
+    if(from == to)
+    {
+      m_bucket[to].m_min[m_slotOf[id]] = mini;
+      m_bucket[to].m_max[m_slotOf[id]] = maxi;
+      return;
+    }
+    Bucket& old = m_bucket[from];
+    const int slot = m_slotOf[id];
+    const int last = old.m_id.back();
+    old.m_min[slot] = old.m_min.back();
+    old.m_max[slot] = old.m_max.back();
+    old.m_id[slot] = last;
+    m_slotOf[last] = slot;
+    old.m_min.pop_back();
+    old.m_max.pop_back();
+    old.m_id.pop_back();
+
+    Bucket& bucket = m_bucket[to];
+    m_bucketOf[id] = to;
+    m_slotOf[id] = bucket.m_id.size();
+    bucket.m_min.push_back(mini);
+    bucket.m_max.push_back(maxi);
+    bucket.m_id.push_back(id);
+  }
+
+  // XYZ bounds come straight from an AABO. With these axes B-A is 2x,
+  // D-C is 2y, and -(A+B) is sqrt(2)z.
+  static void XyzBounds(const AABT mini, const AABT maxi, float3* lo, float3* hi)
+  {
+    lo->x = (mini.b - maxi.a) * 0.5f;
+    hi->x = (maxi.b - mini.a) * 0.5f;
+    lo->y = (mini.d - maxi.c) * 0.5f;
+    hi->y = (maxi.d - mini.c) * 0.5f;
+    lo->z = -(maxi.a + maxi.b) * sqrtf(0.5f);
+    hi->z = -(mini.a + mini.b) * sqrtf(0.5f);
+  }
+
+  int Intersections(const AABT probeMin, const AABT probeMax, std::vector<int>& scratch, int* tested) const
+  {
+    float3 lo, hi;
+    XyzBounds(probeMin, probeMax, &lo, &hi);
+    const int x0 = Cell(lo.x - m_reach);
+    const int x1 = Cell(hi.x + m_reach);
+    const int y0 = Cell(lo.y - m_reach);
+    const int y1 = Cell(hi.y + m_reach);
+    const int z0 = Cell(lo.z - m_reach);
+    const int z1 = Cell(hi.z + m_reach);
+    scratch.clear();
+    for(int z = z0; z <= z1; ++z)
+      for(int y = y0; y <= y1; ++y)
+        for(int x = x0; x <= x1; ++x)
+          scratch.push_back(Hash(x, y, z));
+    // cells that collide in one bucket must only be scanned once
+    std::sort(scratch.begin(), scratch.end());
+    scratch.erase(std::unique(scratch.begin(), scratch.end()), scratch.end());
+
+    int intersections = 0;
+    for(int s = 0; s < scratch.size(); ++s)
+    {
+      const Bucket& bucket = m_bucket[scratch[s]];
+      const int count = bucket.m_id.size();
+      *tested += count;
+      for(int t = 0; t < count; ++t)
+      {
+        const AABT targetMin = bucket.m_min[t];
+        if(targetMin <= probeMax)
+        {
+          const AABT targetMax = bucket.m_max[t];
+          if(probeMin <= targetMax)
+            ++intersections;
+        }
+      }
+    }
+    return intersections;
+  }
+};
+
+uint32_t Part1By2(uint32_t x)
+{
+  x &= 0x000003ff;
+  x = (x ^ (x << 16)) & 0xff0000ff;
+  x = (x ^ (x <<  8)) & 0x0300f00f;
+  x = (x ^ (x <<  4)) & 0x030c30c3;
+  x = (x ^ (x <<  2)) & 0x09249249;
+  return x;
+}
+
+const int kBlock = 64;
+
+// The hierarchy-style alternative in this repo: Morton-sorted columns with a summary
+// octahedron per block of 64. It has to be re-sorted and re-summarized after objects move.
+struct MortonBlocks
+{
+  std::vector<AABT> m_min, m_max;
+  std::vector<AABT> m_blockMin, m_blockMax;
+
+  void Rebuild(const std::vector<AABT>& aabtMin, const std::vector<AABT>& aabtMax)
+  {
+    float4 lo = aabtMin[0];
+    float4 hi = aabtMax[0];
+    for(int o = 1; o < aabtMin.size(); ++o)
+    {
+      lo = min(lo, aabtMin[o]);
+      hi = max(hi, aabtMax[o]);
+    }
+    std::vector<uint64_t> keyed(aabtMin.size());
+    for(int o = 0; o < keyed.size(); ++o)
+    {
+      const float a = ((aabtMin[o].a + aabtMax[o].a) * 0.5f - lo.a) / (hi.a - lo.a) * 1023.f;
+      const float b = ((aabtMin[o].b + aabtMax[o].b) * 0.5f - lo.b) / (hi.b - lo.b) * 1023.f;
+      const float c = ((aabtMin[o].c + aabtMax[o].c) * 0.5f - lo.c) / (hi.c - lo.c) * 1023.f;
+      const uint32_t code = Part1By2((uint32_t)a) | (Part1By2((uint32_t)b) << 1) | (Part1By2((uint32_t)c) << 2);
+      keyed[o] = ((uint64_t)code << 32) | o;
+    }
+    std::sort(keyed.begin(), keyed.end());
+    m_min.resize(keyed.size());
+    m_max.resize(keyed.size());
+    for(int o = 0; o < keyed.size(); ++o)
+    {
+      m_min[o] = aabtMin[(int)keyed[o]];
+      m_max[o] = aabtMax[(int)keyed[o]];
+    }
+    const int blocks = (m_min.size() + kBlock - 1) / kBlock;
+    m_blockMin.resize(blocks);
+    m_blockMax.resize(blocks);
+    for(int b = 0; b < blocks; ++b)
+    {
+      AABT mini = m_min[b * kBlock];
+      AABT maxi = m_max[b * kBlock];
+      const int end = std::min<int>((b + 1) * kBlock, m_min.size());
+      for(int o = b * kBlock + 1; o < end; ++o)
+      {
+        mini.abcd = _mm_min_ps(mini.abcd, m_min[o].abcd);
+        maxi.abcd = _mm_max_ps(maxi.abcd, m_max[o].abcd);
+      }
+      m_blockMin[b] = mini;
+      m_blockMax[b] = maxi;
+    }
+  }
+
+  int Intersections(const AABT probeMin, const AABT probeMax, int* tested) const
+  {
+    int intersections = 0;
+    for(int b = 0; b < m_blockMin.size(); ++b)
+    {
+      if(!(m_blockMin[b] <= probeMax && probeMin <= m_blockMax[b]))
+        continue;
+      const int end = std::min<int>((b + 1) * kBlock, m_min.size());
+      *tested += end - b * kBlock;
+      for(int t = b * kBlock; t < end; ++t)
+      {
+        const AABT targetMin = m_min[t];
+        if(targetMin <= probeMax)
+        {
+          const AABT targetMax = m_max[t];
+          if(probeMin <= targetMax)
+            ++intersections;
+        }
+      }
+    }
+    return intersections;
+  }
+};
+
+int main(int argc, char* argv[])
+{
+  Mesh mesh;
+  mesh.Generate(100, 1.0f);
+  // an AABO sticks out further than the mesh it bounds, so the reach is measured on the AABO
+  float reach = 0.f;
+  {
+    Object origin;
+    origin.m_mesh = &mesh;
+    origin.m_position.x = origin.m_position.y = origin.m_position.z = 0.f;
+    AABT mini, maxi;
+    origin.CalculateAABT(&mini, &maxi);
+    float3 lo, hi;
+    HashGrid::XyzBounds(mini, maxi, &lo, &hi);
+    reach = std::max(std::max(std::max(-lo.x, -lo.y), std::max(-lo.z, hi.x)), std::max(hi.y, hi.z));
+  }
+
+  const int kTests = 100;
+  const int kFrames = 4;
+
+  const int kObjects = 10000000;
+  std::vector<Object> objects(kObjects);
+  std::vector<float3> velocity(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    objects[o].m_mesh = &mesh;
+    objects[o].m_position.x = random(-50.f, 50.f);
+    objects[o].m_position.y = random(-50.f, 50.f);
+    objects[o].m_position.z = random(-50.f, 50.f);
+    velocity[o].x = random(-0.5f, 0.5f);
+    velocity[o].y = random(-0.5f, 0.5f);
+    velocity[o].z = random(-0.5f, 0.5f);
+  }
+
+  std::vector<AABT> aabtMin(kObjects);
+  std::vector<AABT> aabtMax(kObjects);
+  for(int a = 0; a < kObjects; ++a)
+    objects[a].CalculateAABT(&aabtMin[a], &aabtMax[a]);
+
+  const int threads = std::max(1u, std::thread::hardware_concurrency());
+  HashGrid grid(2.f * reach, reach, 1 << 18);
+  MortonBlocks blocks;
+  std::vector<int> scratch;
+
+  {
+    const WallClock clock;
+    grid.Rebuild(objects, aabtMin, aabtMax, threads);
+    const float seconds = clock.seconds();
+
+    printf("Hash grid rebuild of %d objects on %d threads took %f seconds\n", kObjects, threads, seconds);
+  }
+
+  {
+    const WallClock clock;
+    blocks.Rebuild(aabtMin, aabtMax);
+    const float seconds = clock.seconds();
+
+    printf("Morton block rebuild of %d objects took %f seconds\n", kObjects, seconds);
+  }
+
+  for(int frame = 0; frame < kFrames; ++frame)
+  {
+    printf("\nFrame %d\n", frame);
+
+    {
+      const WallClock clock;
+      int intersections = 0;
+      for(int test = 0; test < kTests; ++test)
+      {
+        const AABT probeMin = aabtMin[test];
+        const AABT probeMax = aabtMax[test];
+        for(int t = 0; t < kObjects; ++t)
+        {
+          const AABT targetMin = aabtMin[t];
+          if(targetMin <= probeMax)
+          {
+	    const AABT targetMax = aabtMax[t];
+	    if(probeMin <= targetMax)
+	      ++intersections;
+          }
+        }
+      }
+      const float seconds = clock.seconds();
+
+      printf("AABO SIMD brute force reported %d intersections in %f seconds\n", intersections, seconds);
+    }
+
+    {
+      const WallClock clock;
+      int intersections = 0;
+      int tested = 0;
+      for(int test = 0; test < kTests; ++test)
+        intersections += grid.Intersections(aabtMin[test], aabtMax[test], scratch, &tested);
+      const float seconds = clock.seconds();
+
+      printf("AABO hash grid reported %d intersections in %f seconds, testing %d objects per query\n", intersections, seconds, tested / kTests);
+    }
+
+    {
+      const WallClock clock;
+      int intersections = 0;
+      int tested = 0;
+      for(int test = 0; test < kTests; ++test)
+        intersections += blocks.Intersections(aabtMin[test], aabtMax[test], &tested);
+      const float seconds = clock.seconds();
+
+      printf("AABO Morton blocks reported %d intersections in %f seconds, testing %d objects per query\n", intersections, seconds, tested / kTests);
+    }
+
+    // every object moves, and its AABO is translated rather than recomputed from its mesh
+    for(int o = 0; o < kObjects; ++o)
+    {
+      objects[o].m_position = objects[o].m_position + velocity[o];
+      const float4 delta = xyzToAbcd(velocity[o]);
+      aabtMin[o] = aabtMin[o] + delta;
+      aabtMax[o] = aabtMax[o] + delta;
+    }
+
+    {
+      const WallClock clock;
+      for(int o = 0; o < kObjects; ++o)
+        grid.Move(o, objects[o].m_position, aabtMin[o], aabtMax[o]);
+      const float seconds = clock.seconds();
+
+      printf("Hash grid moved %d objects in %f seconds\n", kObjects, seconds);
+    }
+
+    {
+      const WallClock clock;
+      blocks.Rebuild(aabtMin, aabtMax);
+      const float seconds = clock.seconds();
+
+      printf("Morton blocks rebuilt in %f seconds\n", seconds);
+    }
+  }
+  return 0;
+}
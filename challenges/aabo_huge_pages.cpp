@@ -0,0 +1,423 @@
+#include "stdio.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <stdint.h>
+#include <math.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <immintrin.h>
+
+// Threads scan in parallel here, so this measures elapsed time rather than the
+// CPU time clock() would add up across all of them.
+struct WallClock
+{
+  const std::chrono::steady_clock::time_point m_start;
+  WallClock() : m_start(std::chrono::steady_clock::now())
+  {
+  }
+  float seconds() const
+  {
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    return std::chrono::duration<float>(end - m_start).count();
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+const size_t kHugePage = 2 * 1024 * 1024;
+
+enum PageKind
+{
+  kExplicitHuge,    // MAP_HUGETLB, from the pool reserved in /proc/sys/vm/nr_hugepages
+  kTransparentHuge, // ordinary mapping, with madvise asking khugepaged and the fault path for 2MB pages
+  kSmall            // 4KB pages
+};
+
+const char* const kPageKindName[] = { "explicit 2MB", "transparent 2MB", "4KB" };
+
+// Maps memory for a column without touching it, so the first thread to write each page
+// decides which NUMA node it lands on. Explicit huge pages are tried first, since they can't
+// be split or migrated behind our back, and transparent ones are the fallback. If even
+// ordinary pages can't be mapped there is nothing to measure, so it gives up.
+void* MapColumn(size_t bytes, PageKind* kind)
+{
+  bytes = std::max<size_t>(1, (bytes + kHugePage - 1) / kHugePage) * kHugePage;
+  void* memory = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if(memory != MAP_FAILED)
+  {
+    *kind = kExplicitHuge;
+    return memory;
+  }
+  *kind = kSmall;
+  memory = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(memory == MAP_FAILED)
+  {
+    fprintf(stderr, "can't map %zu bytes for a column: %s\n", bytes, strerror(errno));
+    exit(1);
+  }
+  *kind = madvise(memory, bytes, MADV_HUGEPAGE) == 0 ? kTransparentHuge : kSmall;
+  return memory;
+}
+
+void UnmapColumn(void* memory, size_t bytes)
+{
+  bytes = std::max<size_t>(1, (bytes + kHugePage - 1) / kHugePage) * kHugePage;
+  munmap(memory, bytes);
+}
+
+// The CPUs of each NUMA node, as the kernel lists them in sysfs. A machine without
+// that directory is treated as one node that owns every CPU.
+std::vector<std::vector<int> > NodeCpus()
+{
+  std::vector<std::vector<int> > nodes;
+  for(int node = 0; ; ++node)
+  {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE* file = fopen(path, "r");
+    if(!file)
+      break;
+    std::vector<int> cpus;
+    int first, last;
+    while(fscanf(file, "%d", &first) == 1)
+    {
+      last = first;
+      if(fscanf(file, "-%d", &last) != 1)
+        last = first;
+      for(int cpu = first; cpu <= last; ++cpu)
+        cpus.push_back(cpu);
+      if(fgetc(file) != ',')
+        break;
+    }
+    fclose(file);
+    if(!cpus.empty())
+      nodes.push_back(cpus);
+  }
+  if(nodes.empty())
+  {
+    nodes.resize(1);
+    for(int cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+      nodes[0].push_back(cpu);
+  }
+  return nodes;
+}
+
+// Pins the calling thread. It has to be the thread itself that does this, before it touches
+// anything, or its first pages could be placed while it still ran on another node.
+void PinSelf(const std::vector<int>& cpus)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for(int c = 0; c < cpus.size(); ++c)
+    CPU_SET(cpus[c], &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+int Scan(const AABT* aabtMin, const AABT* aabtMax, int first, int end, const AABT probeMin, const AABT probeMax)
+{
+  int intersections = 0;
+  for(int t = first; t < end; ++t)
+  {
+    const AABT targetMin = aabtMin[t];
+    if(targetMin <= probeMax)
+    {
+      const AABT targetMax = aabtMax[t];
+      if(probeMin <= targetMax)
+        ++intersections;
+    }
+  }
+  return intersections;
+}
+
+// The up and down columns, cut into one slice per NUMA node. Each slice is mapped untouched,
+// filled by threads pinned to its node so first-touch places it there, and queried only by
+// threads pinned to the same node, so a scan never crosses the interconnect.
+struct NumaColumns
+{
+  struct Slice
+  {
+    AABT* m_min;
+    AABT* m_max;
+    int m_first;
+    int m_count;
+    PageKind m_kind;
+  };
+  std::vector<std::vector<int> > m_nodeCpus;
+  std::vector<Slice> m_slice;
+
+  NumaColumns(const std::vector<AABT>& aabtMin, const std::vector<AABT>& aabtMax)
+  : m_nodeCpus(NodeCpus()), m_slice(m_nodeCpus.size())
+  {
+    const int nodes = m_slice.size();
+    const int objects = aabtMin.size();
+    for(int node = 0; node < nodes; ++node)
+    {
+      Slice& slice = m_slice[node];
+      slice.m_first = (int64_t)objects * node / nodes;
+      slice.m_count = (int64_t)objects * (node + 1) / nodes - slice.m_first;
+      PageKind minKind, maxKind;
+      slice.m_min = (AABT*)MapColumn(slice.m_count * sizeof(AABT), &minKind);
+      slice.m_max = (AABT*)MapColumn(slice.m_count * sizeof(AABT), &maxKind);
+      slice.m_kind = std::max(minKind, maxKind);
+    }
+    ForEachThread([&](int node, int thread, int threads)
+    {
+      const Slice& slice = m_slice[node];
+      const int first = (int64_t)slice.m_count * thread / threads;
+      const int end = (int64_t)slice.m_count * (thread + 1) / threads;
+      for(int t = first; t < end; ++t)
+      {
+        slice.m_min[t] = aabtMin[slice.m_first + t];
+        slice.m_max[t] = aabtMax[slice.m_first + t];
+      }
+    });
+  }
+
+  ~NumaColumns()
+  {
+    for(int node = 0; node < m_slice.size(); ++node)
+    {
+      UnmapColumn(m_slice[node].m_min, m_slice[node].m_count * sizeof(AABT));
+      UnmapColumn(m_slice[node].m_max, m_slice[node].m_count * sizeof(AABT));
+    }
+  }
+
+  // Runs one thread per CPU, each pinned to its node, and waits for them all.
+  template<typename Work> void ForEachThread(Work work) const
+  {
+    std::vector<std::thread> worker;
+    for(int node = 0; node < m_nodeCpus.size(); ++node)
+    {
+      const int threads = m_nodeCpus[node].size();
+      const std::vector<int>& cpus = m_nodeCpus[node];
+      for(int thread = 0; thread < threads; ++thread)
+        worker.push_back(std::thread([=, &cpus]()
+        {
+          PinSelf(cpus);
+          work(node, thread, threads);
+        }));
+    }
+    for(int w = 0; w < worker.size(); ++w)
+      worker[w].join();
+  }
+
+  int Intersections(const std::vector<AABT>& probeMin, const std::vector<AABT>& probeMax) const
+  {
+    std::atomic<int> intersections(0);
+    ForEachThread([&](int node, int thread, int threads)
+    {
+      const Slice& slice = m_slice[node];
+      const int first = (int64_t)slice.m_count * thread / threads;
+      const int end = (int64_t)slice.m_count * (thread + 1) / threads;
+      int mine = 0;
+      for(int test = 0; test < probeMin.size(); ++test)
+        mine += Scan(slice.m_min, slice.m_max, first, end, probeMin[test], probeMax[test]);
+      intersections += mine;
+    });
+    return intersections;
+  }
+};
+
+int main(int argc, char* argv[])
+{
+  Mesh mesh;
+  mesh.Generate(100, 1.0f);
+
+  const int kTests = 100;
+
+  const int kObjects = 10000000;
+  std::vector<Object> objects(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    objects[o].m_mesh = &mesh;
+    objects[o].m_position.x = random(-50.f, 50.f);
+    objects[o].m_position.y = random(-50.f, 50.f);
+    objects[o].m_position.z = random(-50.f, 50.f);
+  }
+
+  std::vector<AABT> aabtMin(kObjects);
+  std::vector<AABT> aabtMax(kObjects);
+  for(int a = 0; a < kObjects; ++a)
+    objects[a].CalculateAABT(&aabtMin[a], &aabtMax[a]);
+
+  const std::vector<AABT> probeMin(aabtMin.begin(), aabtMin.begin() + kTests);
+  const std::vector<AABT> probeMax(aabtMax.begin(), aabtMax.begin() + kTests);
+
+  {
+    const WallClock clock;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+      intersections += Scan(aabtMin.data(), aabtMax.data(), 0, kObjects, probeMin[test], probeMax[test]);
+    const float seconds = clock.seconds();
+
+    printf("AABO SIMD, std::vector, 1 thread, reported %d intersections in %f seconds\n", intersections, seconds);
+  }
+
+  {
+    PageKind minKind, maxKind;
+    AABT* hugeMin = (AABT*)MapColumn(kObjects * sizeof(AABT), &minKind);
+    AABT* hugeMax = (AABT*)MapColumn(kObjects * sizeof(AABT), &maxKind);
+    std::copy(aabtMin.begin(), aabtMin.end(), hugeMin);
+    std::copy(aabtMax.begin(), aabtMax.end(), hugeMax);
+
+    const WallClock clock;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+      intersections += Scan(hugeMin, hugeMax, 0, kObjects, probeMin[test], probeMax[test]);
+    const float seconds = clock.seconds();
+
+    printf("AABO SIMD, %s pages, 1 thread, reported %d intersections in %f seconds\n", kPageKindName[std::max(minKind, maxKind)], intersections, seconds);
+    UnmapColumn(hugeMin, kObjects * sizeof(AABT));
+    UnmapColumn(hugeMax, kObjects * sizeof(AABT));
+  }
+
+  const NumaColumns numa(aabtMin, aabtMax);
+  int threads = 0;
+  for(int node = 0; node < numa.m_nodeCpus.size(); ++node)
+    threads += numa.m_nodeCpus[node].size();
+
+  {
+    // every page was first touched by the main thread, so on a multi-socket machine
+    // they all live on one node and the other sockets scan them remotely
+    const WallClock clock;
+    std::atomic<int> intersections(0);
+    std::vector<std::thread> worker;
+    for(int thread = 0; thread < threads; ++thread)
+      worker.push_back(std::thread([&, thread]()
+      {
+        const int first = (int64_t)kObjects * thread / threads;
+        const int end = (int64_t)kObjects * (thread + 1) / threads;
+        int mine = 0;
+        for(int test = 0; test < kTests; ++test)
+          mine += Scan(aabtMin.data(), aabtMax.data(), first, end, probeMin[test], probeMax[test]);
+        intersections += mine;
+      }));
+    for(int thread = 0; thread < threads; ++thread)
+      worker[thread].join();
+    const float seconds = clock.seconds();
+
+    printf("AABO SIMD, std::vector, %d unpinned threads, reported %d intersections in %f seconds\n", threads, (int)intersections, seconds);
+  }
+
+  {
+    const WallClock clock;
+    const int intersections = numa.Intersections(probeMin, probeMax);
+    const float seconds = clock.seconds();
+
+    printf("AABO SIMD, %s pages on %d NUMA nodes, %d pinned threads, reported %d intersections in %f seconds\n",
+           kPageKindName[numa.m_slice[0].m_kind], (int)numa.m_slice.size(), threads, intersections, seconds);
+  }
+  return 0;
+}
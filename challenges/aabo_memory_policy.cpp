@@ -0,0 +1,336 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include <immintrin.h>
+
+// The scan and the victim run on threads of their own at once, and clock() would add the
+// two together, so each is timed by the CPU time of its own thread.
+struct ThreadClock
+{
+  const double m_start;
+  ThreadClock() : m_start(now())
+  {
+  }
+  static double now()
+  {
+    timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+  }
+  float seconds() const
+  {
+    return now() - m_start;
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+enum Policy
+{
+  kPlain,       // ordinary loads, hardware prefetch only
+  kPrefetch,    // software prefetch of the up column, some distance ahead
+  kStreaming,   // non-temporal prefetch and loads of the up column
+  kStreamingDown // as above, plus prefetch of the down entries of partial accepts
+};
+
+const char* const kPolicyName[] =
+{
+  "plain",
+  "prefetch",
+  "streaming",
+  "streaming + down prefetch",
+};
+
+const int kLine = 64 / sizeof(AABT); // AABTs per cache line
+const int kGroup = 256;              // objects whose partial accepts are prefetched together
+
+// The up column is read exactly once per query, so there's no point in keeping it cached.
+// prefetchnta brings a line close to the core while keeping it out of most of the cache
+// hierarchy, so the scan doesn't flush out what the rest of the process was using.
+// movntdqa only bypasses the cache on write-combining memory; on ordinary memory it is a
+// plain load, but it's used here so the kernel is right on hardware where it does more.
+template<Policy kPolicy> int Scan(const AABT* aabtMin, const AABT* aabtMax, int objects, const AABT probeMin, const AABT probeMax, int distance)
+{
+  int intersections = 0;
+  if(kPolicy == kStreamingDown)
+  {
+    int candidate[kGroup];
+    for(int first = 0; first < objects; first += kGroup)
+    {
+      const int end = std::min(first + kGroup, objects);
+      int n = 0;
+      for(int t = first; t < end; ++t)
+      {
+        if((t & (kLine - 1)) == 0)
+          _mm_prefetch((const char*)&aabtMin[std::min(t + distance, objects - 1)], _MM_HINT_NTA);
+        AABT targetMin;
+        targetMin.abcd = _mm_castsi128_ps(_mm_stream_load_si128((__m128i*)&aabtMin[t]));
+        candidate[n] = t;
+        n += targetMin <= probeMax;
+      }
+      // every down entry this group needs is requested before any of them is used
+      for(int c = 0; c < n; ++c)
+        _mm_prefetch((const char*)&aabtMax[candidate[c]], _MM_HINT_T0);
+      for(int c = 0; c < n; ++c)
+        intersections += probeMin <= aabtMax[candidate[c]];
+    }
+    return intersections;
+  }
+  for(int t = 0; t < objects; ++t)
+  {
+    AABT targetMin;
+    if(kPolicy == kPrefetch)
+    {
+      if((t & (kLine - 1)) == 0)
+        _mm_prefetch((const char*)&aabtMin[std::min(t + distance, objects - 1)], _MM_HINT_T0);
+      targetMin = aabtMin[t];
+    }
+    else if(kPolicy == kStreaming)
+    {
+      if((t & (kLine - 1)) == 0)
+        _mm_prefetch((const char*)&aabtMin[std::min(t + distance, objects - 1)], _MM_HINT_NTA);
+      targetMin.abcd = _mm_castsi128_ps(_mm_stream_load_si128((__m128i*)&aabtMin[t]));
+    }
+    else
+      targetMin = aabtMin[t];
+    if(targetMin <= probeMax)
+    {
+      const AABT targetMax = aabtMax[t];
+      if(probeMin <= targetMax)
+        ++intersections;
+    }
+  }
+  return intersections;
+}
+
+// Stands in for the rest of the process: random reads from a table that fits in cache,
+// if nothing else has evicted it.
+struct Victim
+{
+  std::vector<int> m_table;
+  std::vector<int> m_index;
+  Victim(int bytes, int reads) : m_table(bytes / sizeof(int)), m_index(reads)
+  {
+    for(int i = 0; i < m_table.size(); ++i)
+      m_table[i] = i;
+    for(int r = 0; r < reads; ++r)
+      m_index[r] = rand() % m_table.size();
+  }
+  uint64_t Run() const
+  {
+    uint64_t sum = 0;
+    for(int r = 0; r < m_index.size(); ++r)
+      sum += m_table[m_index[r]];
+    return sum;
+  }
+};
+
+struct Result
+{
+  int m_intersections;
+  float m_scanSeconds;
+  float m_victimSeconds; // for as many runs of the victim as there are queries
+  uint64_t m_checksum;
+};
+
+// Runs the queries while the victim runs over and over on another thread, so the two share
+// the cache as they would in a real process, and times each by its own CPU time. On one
+// core the two take turns, and the victim still finds its table evicted by the scan.
+template<Policy kPolicy> Result Measure(const std::vector<AABT>& aabtMin, const std::vector<AABT>& aabtMax, int tests, int distance, const Victim& victim)
+{
+  Result result = {0, 0.f, 0.f, 0};
+  std::atomic<bool> done(false);
+  int runs = 0;
+  float victimSeconds = 0.f;
+  std::thread victimThread([&]()
+  {
+    const ThreadClock clock;
+    while(!done.load(std::memory_order_relaxed))
+    {
+      result.m_checksum += victim.Run();
+      ++runs;
+    }
+    victimSeconds = clock.seconds();
+  });
+  {
+    const ThreadClock clock;
+    for(int test = 0; test < tests; ++test)
+      result.m_intersections += Scan<kPolicy>(aabtMin.data(), aabtMax.data(), aabtMin.size(), aabtMin[test], aabtMax[test], distance);
+    result.m_scanSeconds = clock.seconds();
+  }
+  done = true;
+  victimThread.join();
+  result.m_victimSeconds = runs ? victimSeconds * tests / runs : 0.f;
+  return result;
+}
+
+int main(int argc, char* argv[])
+{
+  Mesh mesh;
+  mesh.Generate(100, 1.0f);
+
+  const int kTests = 100;
+
+  const int kObjects = 10000000;
+  std::vector<Object> objects(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    objects[o].m_mesh = &mesh;
+    objects[o].m_position.x = random(-50.f, 50.f);
+    objects[o].m_position.y = random(-50.f, 50.f);
+    objects[o].m_position.z = random(-50.f, 50.f);
+  }
+
+  std::vector<AABT> aabtMin(kObjects);
+  std::vector<AABT> aabtMax(kObjects);
+  for(int a = 0; a < kObjects; ++a)
+    objects[a].CalculateAABT(&aabtMin[a], &aabtMax[a]);
+
+  const Victim victim(2 * 1024 * 1024, 1 << 20);
+  {
+    victim.Run();
+    const ThreadClock clock;
+    uint64_t sum = 0;
+    for(int test = 0; test < kTests; ++test)
+      sum += victim.Run();
+    const float seconds = clock.seconds();
+
+    printf("%29s | %9s | %7s | %7s | %7s | %15s\n", "Memory Policy", "distance", "accepts", "scan", "victim", "checksum");
+    printf("------------------------------------------------------------------------------------------\n");
+    printf("%29s | %9s | %7s | %7s | %7.4f | %15llu\n", "victim alone", "", "", "", seconds, (unsigned long long)sum);
+  }
+
+  const char *format = "%29s | %9d | %7d | %7.4f | %7.4f | %15llu\n";
+  const int kDistance[] = {0, 16, 64, 256, 1024};
+
+  {
+    const Result r = Measure<kPlain>(aabtMin, aabtMax, kTests, 0, victim);
+    printf(format, kPolicyName[kPlain], 0, r.m_intersections, r.m_scanSeconds, r.m_victimSeconds, (unsigned long long)r.m_checksum);
+  }
+  for(int d = 1; d < sizeof(kDistance) / sizeof(kDistance[0]); ++d)
+  {
+    const Result r = Measure<kPrefetch>(aabtMin, aabtMax, kTests, kDistance[d], victim);
+    printf(format, kPolicyName[kPrefetch], kDistance[d], r.m_intersections, r.m_scanSeconds, r.m_victimSeconds, (unsigned long long)r.m_checksum);
+  }
+  for(int d = 1; d < sizeof(kDistance) / sizeof(kDistance[0]); ++d)
+  {
+    const Result r = Measure<kStreaming>(aabtMin, aabtMax, kTests, kDistance[d], victim);
+    printf(format, kPolicyName[kStreaming], kDistance[d], r.m_intersections, r.m_scanSeconds, r.m_victimSeconds, (unsigned long long)r.m_checksum);
+  }
+  for(int d = 1; d < sizeof(kDistance) / sizeof(kDistance[0]); ++d)
+  {
+    const Result r = Measure<kStreamingDown>(aabtMin, aabtMax, kTests, kDistance[d], victim);
+    printf(format, kPolicyName[kStreamingDown], kDistance[d], r.m_intersections, r.m_scanSeconds, r.m_victimSeconds, (unsigned long long)r.m_checksum);
+  }
+  return 0;
+}
@@ -0,0 +1,416 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <stdint.h>
+#include <math.h>
+#include <immintrin.h>
+
+// clock() adds up the CPU time of every thread, so the parallel sort would look
+// slower the more threads it used. Wall time is what a frame budget cares about.
+struct WallClock
+{
+  const std::chrono::steady_clock::time_point m_start;
+  WallClock() : m_start(std::chrono::steady_clock::now())
+  {
+  }
+  float seconds() const
+  {
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    return std::chrono::duration<float>(end - m_start).count();
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+// Spreads the low 10 bits of x out so that there are two zero bits between each.
+uint32_t Part1By2(uint32_t x)
+{
+  x &= 0x000003ff;
+  x = (x ^ (x << 16)) & 0xff0000ff;
+  x = (x ^ (x <<  8)) & 0x0300f00f;
+  x = (x ^ (x <<  4)) & 0x030c30c3;
+  x = (x ^ (x <<  2)) & 0x09249249;
+  return x;
+}
+
+// Three of the four ABCD axes already span 3D, so the Morton code of an AABO
+// is made from the A, B and C of its centroid. Nothing has to go back to XYZ.
+struct MortonQuantizer
+{
+  float4 m_origin;
+  float4 m_scale;
+  MortonQuantizer(const std::vector<AABT>& aabtMin, const std::vector<AABT>& aabtMax)
+  {
+    float4 lo = aabtMin[0];
+    float4 hi = aabtMax[0];
+    for(int o = 1; o < aabtMin.size(); ++o)
+    {
+      lo = min(lo, aabtMin[o]);
+      hi = max(hi, aabtMax[o]);
+    }
+    m_origin = lo;
+    m_scale.abcd = _mm_div_ps(_mm_set1_ps(1023.f), _mm_max_ps(_mm_sub_ps(hi.abcd, lo.abcd), _mm_set1_ps(1e-6f)));
+  }
+  uint32_t Code(const AABT mini, const AABT maxi) const
+  {
+    float4 centroid;
+    centroid.abcd = _mm_mul_ps(_mm_add_ps(mini.abcd, maxi.abcd), _mm_set1_ps(0.5f));
+    float4 cell;
+    cell.abcd = _mm_mul_ps(_mm_sub_ps(centroid.abcd, m_origin.abcd), m_scale.abcd);
+    return Part1By2((uint32_t)cell.a) | (Part1By2((uint32_t)cell.b) << 1) | (Part1By2((uint32_t)cell.c) << 2);
+  }
+};
+
+struct Keyed
+{
+  uint32_t m_key;
+  int m_index;
+};
+
+// Least-significant-digit radix sort, 8 bits per pass. Each thread counts digits in its
+// own slice, and since the prefix sum runs over (digit, thread) the scatter is stable.
+void RadixSort(std::vector<Keyed>& keyed, int threads)
+{
+  const int count = keyed.size();
+  std::vector<Keyed> scratch(count);
+  std::vector<int> histogram(threads * 256);
+  Keyed* from = keyed.data();
+  Keyed* to = scratch.data();
+  for(int shift = 0; shift < 32; shift += 8)
+  {
+    std::fill(histogram.begin(), histogram.end(), 0);
+    std::vector<std::thread> worker;
+    for(int thread = 0; thread < threads; ++thread)
+      worker.push_back(std::thread([=, &histogram]()
+      {
+        int* bucket = &histogram[thread * 256];
+        const int first = (int64_t)count * thread / threads;
+        const int end = (int64_t)count * (thread + 1) / threads;
+        for(int k = first; k < end; ++k)
+          ++bucket[(from[k].m_key >> shift) & 0xff];
+      }));
+    for(int thread = 0; thread < threads; ++thread)
+      worker[thread].join();
+    worker.clear();
+
+    int offset = 0;
+    for(int digit = 0; digit < 256; ++digit)
+      for(int thread = 0; thread < threads; ++thread)
+      {
+        const int n = histogram[thread * 256 + digit];
+        histogram[thread * 256 + digit] = offset;
+        offset += n;
+      }
+
+    for(int thread = 0; thread < threads; ++thread)
+      worker.push_back(std::thread([=, &histogram]()
+      {
+        int* bucket = &histogram[thread * 256];
+        const int first = (int64_t)count * thread / threads;
+        const int end = (int64_t)count * (thread + 1) / threads;
+        for(int k = first; k < end; ++k)
+          to[bucket[(from[k].m_key >> shift) & 0xff]++] = from[k];
+      }));
+    for(int thread = 0; thread < threads; ++thread)
+      worker[thread].join();
+
+    std::swap(from, to);
+  }
+  // an even number of passes leaves the result where it started
+}
+
+// Returns the permutation that sorts objects by the Morton code of their AABO centroid.
+// order[new] is the old index of the object that moves to new.
+std::vector<int> MortonOrder(const std::vector<AABT>& aabtMin, const std::vector<AABT>& aabtMax, int threads)
+{
+  const MortonQuantizer quantizer(aabtMin, aabtMax);
+  std::vector<Keyed> keyed(aabtMin.size());
+  for(int o = 0; o < keyed.size(); ++o)
+  {
+    keyed[o].m_key = quantizer.Code(aabtMin[o], aabtMax[o]);
+    keyed[o].m_index = o;
+  }
+  RadixSort(keyed, threads);
+  std::vector<int> order(keyed.size());
+  for(int o = 0; o < order.size(); ++o)
+    order[o] = keyed[o].m_index;
+  return order;
+}
+
+template<typename T> void Reorder(std::vector<T>& column, const std::vector<int>& order)
+{
+  std::vector<T> reordered(column.size());
+  for(int o = 0; o < order.size(); ++o)
+    reordered[o] = column[order[o]];
+  column.swap(reordered);
+}
+
+const int kBlock = 64; // objects per block summary
+
+// One up and one down tetrahedron that enclose a block of consecutive objects.
+// A probe that misses the summary can't hit anything in the block.
+void Summarize(const std::vector<AABT>& aabtMin, const std::vector<AABT>& aabtMax, std::vector<AABT>* blockMin, std::vector<AABT>* blockMax)
+{
+  const int blocks = (aabtMin.size() + kBlock - 1) / kBlock;
+  blockMin->resize(blocks);
+  blockMax->resize(blocks);
+  for(int b = 0; b < blocks; ++b)
+  {
+    AABT mini = aabtMin[b * kBlock];
+    AABT maxi = aabtMax[b * kBlock];
+    const int end = std::min<int>((b + 1) * kBlock, aabtMin.size());
+    for(int o = b * kBlock + 1; o < end; ++o)
+    {
+      mini.abcd = _mm_min_ps(mini.abcd, aabtMin[o].abcd);
+      maxi.abcd = _mm_max_ps(maxi.abcd, aabtMax[o].abcd);
+    }
+    (*blockMin)[b] = mini;
+    (*blockMax)[b] = maxi;
+  }
+}
+
+int Scan(const std::vector<AABT>& aabtMin, const std::vector<AABT>& aabtMax, const std::vector<AABT>& probeMin, const std::vector<AABT>& probeMax)
+{
+  int intersections = 0;
+  for(int test = 0; test < probeMin.size(); ++test)
+  {
+    const AABT queryMin = probeMin[test];
+    const AABT queryMax = probeMax[test];
+    for(int t = 0; t < aabtMin.size(); ++t)
+    {
+      const AABT targetMin = aabtMin[t];
+      if(targetMin <= queryMax)
+      {
+        const AABT targetMax = aabtMax[t];
+        if(queryMin <= targetMax)
+          ++intersections;
+      }
+    }
+  }
+  return intersections;
+}
+
+int BlockScan(const std::vector<AABT>& aabtMin, const std::vector<AABT>& aabtMax, const std::vector<AABT>& blockMin, const std::vector<AABT>& blockMax,
+              const std::vector<AABT>& probeMin, const std::vector<AABT>& probeMax, int* visited)
+{
+  int intersections = 0;
+  *visited = 0;
+  for(int test = 0; test < probeMin.size(); ++test)
+  {
+    const AABT queryMin = probeMin[test];
+    const AABT queryMax = probeMax[test];
+    for(int b = 0; b < blockMin.size(); ++b)
+    {
+      if(!(blockMin[b] <= queryMax && queryMin <= blockMax[b]))
+        continue;
+      ++*visited;
+      const int end = std::min<int>((b + 1) * kBlock, aabtMin.size());
+      for(int t = b * kBlock; t < end; ++t)
+      {
+        const AABT targetMin = aabtMin[t];
+        if(targetMin <= queryMax)
+        {
+          const AABT targetMax = aabtMax[t];
+          if(queryMin <= targetMax)
+            ++intersections;
+        }
+      }
+    }
+  }
+  return intersections;
+}
+
+int main(int argc, char* argv[])
+{
+  Mesh mesh;
+  mesh.Generate(100, 1.0f);
+
+  const int kTests = 100;
+
+  const int kObjects = 10000000;
+  std::vector<Object> objects(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    objects[o].m_mesh = &mesh;
+    objects[o].m_position.x = random(-50.f, 50.f);
+    objects[o].m_position.y = random(-50.f, 50.f);
+    objects[o].m_position.z = random(-50.f, 50.f);
+  }
+
+  std::vector<AABT> aabtMin(kObjects);
+  std::vector<AABT> aabtMax(kObjects);
+  for(int a = 0; a < kObjects; ++a)
+    objects[a].CalculateAABT(&aabtMin[a], &aabtMax[a]);
+
+  // the probes stay the same objects whatever order the columns are in
+  const std::vector<AABT> probeMin(aabtMin.begin(), aabtMin.begin() + kTests);
+  const std::vector<AABT> probeMax(aabtMax.begin(), aabtMax.begin() + kTests);
+
+  std::vector<AABT> blockMin, blockMax;
+  Summarize(aabtMin, aabtMax, &blockMin, &blockMax);
+  const int blocks = blockMin.size();
+
+  {
+    const WallClock clock;
+    const int intersections = Scan(aabtMin, aabtMax, probeMin, probeMax);
+    const float seconds = clock.seconds();
+
+    printf("AABO SIMD, random order, reported %d intersections in %f seconds\n", intersections, seconds);
+  }
+
+  {
+    const WallClock clock;
+    int visited;
+    const int intersections = BlockScan(aabtMin, aabtMax, blockMin, blockMax, probeMin, probeMax, &visited);
+    const float seconds = clock.seconds();
+
+    printf("AABO SIMD blocks, random order, reported %d intersections in %f seconds, visiting %.2f%% of blocks\n", intersections, seconds, 100.f * visited / ((float)blocks * kTests));
+  }
+
+  const int threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<int> order;
+  {
+    const WallClock clock;
+    order = MortonOrder(aabtMin, aabtMax, threads);
+    Reorder(aabtMin, order);
+    Reorder(aabtMax, order);
+    const float seconds = clock.seconds();
+
+    printf("Morton reorder of %d objects on %d threads took %f seconds\n", kObjects, threads, seconds);
+  }
+
+  // objects[] and anything else indexed the old way can be remapped through the inverse
+  std::vector<int> remap(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+    remap[order[o]] = o;
+  for(int test = 0; test < kTests; ++test)
+    if(!(aabtMin[remap[test]] <= probeMin[test] && probeMin[test] <= aabtMin[remap[test]]))
+      printf("remap is broken for object %d\n", test);
+
+  Summarize(aabtMin, aabtMax, &blockMin, &blockMax);
+
+  {
+    const WallClock clock;
+    const int intersections = Scan(aabtMin, aabtMax, probeMin, probeMax);
+    const float seconds = clock.seconds();
+
+    printf("AABO SIMD, Morton order, reported %d intersections in %f seconds\n", intersections, seconds);
+  }
+
+  {
+    const WallClock clock;
+    int visited;
+    const int intersections = BlockScan(aabtMin, aabtMax, blockMin, blockMax, probeMin, probeMax, &visited);
+    const float seconds = clock.seconds();
+
+    printf("AABO SIMD blocks, Morton order, reported %d intersections in %f seconds, visiting %.2f%% of blocks\n", intersections, seconds, 100.f * visited / ((float)blocks * kTests));
+  }
+  return 0;
+}
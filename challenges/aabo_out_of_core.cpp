@@ -0,0 +1,408 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <time.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <immintrin.h>
+
+// Clock measures CPU time, which doesn't count time spent waiting for the disk,
+// so the out-of-core scans are timed with a wall clock instead.
+struct WallClock
+{
+  const std::chrono::steady_clock::time_point m_start;
+  WallClock() : m_start(std::chrono::steady_clock::now())
+  {
+  }
+  float seconds() const
+  {
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    return std::chrono::duration<float>(end - m_start).count();
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+// A scan that carried on after a failed read would report counts from stale data, so any
+// failure of the file is the end of the run.
+void Fail(const char* what, const char* path)
+{
+  fprintf(stderr, "%s %s failed: %s\n", what, path, errno ? strerror(errno) : "unexpected end of file");
+  exit(1);
+}
+
+// A column of AABTs that lives in a file instead of in memory.
+// Reads are positional, so several can be in flight on different threads.
+struct Column
+{
+  int m_file;
+  int m_objects;
+  const char* m_path;
+  Column(const char* path, const std::vector<AABT>& aabt) : m_objects(aabt.size()), m_path(path)
+  {
+    m_file = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if(m_file < 0)
+      Fail("open", path);
+    const char* bytes = (const char*)aabt.data();
+    size_t remaining = aabt.size() * sizeof(AABT);
+    while(remaining > 0)
+    {
+      errno = 0;
+      const ssize_t written = write(m_file, bytes, remaining);
+      if(written < 0 && errno == EINTR)
+        continue;
+      if(written <= 0)
+        Fail("write", path);
+      bytes += written;
+      remaining -= written;
+    }
+    if(fsync(m_file) != 0)
+      Fail("fsync", path);
+    unlink(path); // the file goes away when it is closed
+  }
+  ~Column()
+  {
+    close(m_file);
+  }
+  void Read(AABT* aabt, int first, int count) const
+  {
+    char* bytes = (char*)aabt;
+    size_t remaining = (size_t)count * sizeof(AABT);
+    off_t offset = (off_t)first * sizeof(AABT);
+    while(remaining > 0)
+    {
+      errno = 0;
+      const ssize_t got = pread(m_file, bytes, remaining, offset);
+      if(got < 0 && errno == EINTR)
+        continue;
+      if(got <= 0)
+        Fail("pread", m_path);
+      bytes += got;
+      offset += got;
+      remaining -= got;
+    }
+  }
+  void Evict() const
+  {
+    posix_fadvise(m_file, 0, 0, POSIX_FADV_DONTNEED); // so each scan is cold, as it would be with more data than RAM
+  }
+};
+
+struct Partial
+{
+  int m_object;
+  int m_probe;
+  bool operator<(const Partial& other) const
+  {
+    return m_object < other.m_object;
+  }
+};
+
+const int kChunk = 1 << 20; // objects per sequential read, 16MB
+const int kBlock = 4096;    // objects per in-cache block, 64KB
+const int kPage  = 256;     // AABTs per random read, 4KB
+const int kGap   = 16;      // unwanted pages worth reading to avoid another seek
+const int kRun   = 256;     // most pages per random read, 1MB
+
+// Streams a column through two chunk buffers. While the caller tests one chunk,
+// a thread reads the next into the other buffer.
+template<typename Visitor> void Stream(const Column& column, int objects, Visitor& visitor)
+{
+  std::vector<AABT> buffer[2];
+  buffer[0].resize(kChunk);
+  buffer[1].resize(kChunk);
+  column.Read(buffer[0].data(), 0, std::min(kChunk, objects));
+  for(int first = 0, current = 0; first < objects; first += kChunk, current ^= 1)
+  {
+    const int next = first + kChunk;
+    std::thread reader;
+    if(next < objects)
+      reader = std::thread(&Column::Read, &column, buffer[current ^ 1].data(), next, std::min(kChunk, objects - next));
+    visitor(buffer[current].data(), first, std::min(kChunk, objects - first));
+    if(reader.joinable())
+      reader.join();
+  }
+}
+
+// Tests the up tetrahedra of a chunk against every probe's down tetrahedron,
+// and remembers which pairs need their down tetrahedron checked.
+struct UpVisitor
+{
+  const std::vector<AABT>& m_probeMax;
+  std::vector<Partial> m_partial;
+  UpVisitor(const std::vector<AABT>& probeMax) : m_probeMax(probeMax)
+  {
+  }
+  void operator()(const AABT* targetMin, int first, int count)
+  {
+    for(int block = 0; block < count; block += kBlock)
+    {
+      const int end = std::min(block + kBlock, count);
+      for(int probe = 0; probe < m_probeMax.size(); ++probe)
+      {
+        const AABT probeMax = m_probeMax[probe];
+        for(int t = block; t < end; ++t)
+          if(targetMin[t] <= probeMax)
+          {
+            const Partial partial = {first + t, probe};
+            m_partial.push_back(partial);
+          }
+      }
+    }
+  }
+};
+
+// Tests both tetrahedra of a chunk, for comparison with reading only the up column.
+struct BothVisitor
+{
+  const Column& m_down;
+  const std::vector<AABT>& m_probeMin;
+  const std::vector<AABT>& m_probeMax;
+  std::vector<AABT> m_targetMax;
+  int m_intersections;
+  BothVisitor(const Column& down, const std::vector<AABT>& probeMin, const std::vector<AABT>& probeMax)
+  : m_down(down), m_probeMin(probeMin), m_probeMax(probeMax), m_targetMax(kChunk), m_intersections(0)
+  {
+  }
+  void operator()(const AABT* targetMin, int first, int count)
+  {
+    m_down.Read(m_targetMax.data(), first, count);
+    for(int block = 0; block < count; block += kBlock)
+    {
+      const int end = std::min(block + kBlock, count);
+      for(int probe = 0; probe < m_probeMax.size(); ++probe)
+      {
+        const AABT probeMin = m_probeMin[probe];
+        const AABT probeMax = m_probeMax[probe];
+        for(int t = block; t < end; ++t)
+          if(targetMin[t] <= probeMax && probeMin <= m_targetMax[t])
+            ++m_intersections;
+      }
+    }
+  }
+};
+
+// Fetches the down tetrahedra of partial accepts in sorted order, so the down column
+// is read front to back. Wanted pages that are close together are read as one run,
+// since reading a few unwanted pages is cheaper than seeking past them.
+int ConfirmPartials(const Column& down, std::vector<Partial>& partial, const std::vector<AABT>& probeMin, int* pages)
+{
+  std::sort(partial.begin(), partial.end());
+  std::vector<AABT> run(kRun * kPage);
+  int first = 0;
+  int end = 0;
+  int intersections = 0;
+  *pages = 0;
+  for(int p = 0; p < partial.size(); ++p)
+  {
+    const int object = partial[p].m_object;
+    if(object >= end)
+    {
+      first = object / kPage * kPage;
+      end = first + kPage;
+      for(int q = p + 1; q < partial.size(); ++q)
+      {
+        const int next = partial[q].m_object / kPage * kPage + kPage;
+        if(next - end > kGap * kPage || next - first > kRun * kPage)
+          break;
+        end = std::max(end, next);
+      }
+      end = std::min(end, down.m_objects); // the last page may be partly past the end of the column
+      down.Read(run.data(), first, end - first);
+      *pages += (end - first + kPage - 1) / kPage;
+    }
+    if(probeMin[partial[p].m_probe] <= run[object - first])
+      ++intersections;
+  }
+  return intersections;
+}
+
+int main(int argc, char* argv[])
+{
+  Mesh mesh;
+  mesh.Generate(100, 1.0f);
+
+  const int kTests = 100;
+
+  const int kObjects = 10000000;
+  std::vector<Object> objects(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    objects[o].m_mesh = &mesh;
+    objects[o].m_position.x = random(-50.f, 50.f);
+    objects[o].m_position.y = random(-50.f, 50.f);
+    objects[o].m_position.z = random(-50.f, 50.f);
+  }
+
+  std::vector<AABT> aabtMin(kObjects);
+  std::vector<AABT> aabtMax(kObjects);
+  for(int a = 0; a < kObjects; ++a)
+    objects[a].CalculateAABT(&aabtMin[a], &aabtMax[a]);
+
+  std::vector<AABT> probeMin(aabtMin.begin(), aabtMin.begin() + kTests);
+  std::vector<AABT> probeMax(aabtMax.begin(), aabtMax.begin() + kTests);
+
+  {
+    const WallClock clock;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+    {
+      const AABT probeMin = aabtMin[test];
+      const AABT probeMax = aabtMax[test];
+      for(int t = 0; t < kObjects; ++t)
+      {
+        const AABT targetMin = aabtMin[t];
+        if(targetMin <= probeMax)
+        {
+	  const AABT targetMax = aabtMax[t];
+	  if(probeMin <= targetMax)
+	    ++intersections;
+        }
+      }
+    }
+    const float seconds = clock.seconds();
+
+    printf("In-memory AABO SIMD reported %d intersections in %f seconds\n", intersections, seconds);
+  }
+
+  const Column up("aabo_up.bin", aabtMin);
+  const Column down("aabo_down.bin", aabtMax);
+  const float megabytes = kObjects * sizeof(AABT) / (1024.f * 1024.f);
+
+  {
+    up.Evict();
+    down.Evict();
+    const WallClock clock;
+    BothVisitor visitor(down, probeMin, probeMax);
+    Stream(up, kObjects, visitor);
+    const float seconds = clock.seconds();
+
+    printf("Out-of-core AABO, both columns, reported %d intersections in %f seconds, reading %.1f MB\n", visitor.m_intersections, seconds, 2 * megabytes);
+  }
+
+  {
+    up.Evict();
+    down.Evict();
+    const WallClock clock;
+    UpVisitor visitor(probeMax);
+    Stream(up, kObjects, visitor);
+    int pages;
+    const int intersections = ConfirmPartials(down, visitor.m_partial, probeMin, &pages);
+    const float seconds = clock.seconds();
+
+    printf("Out-of-core AABO, up column then sorted down pages, reported %d intersections (%d partial accepts) in %f seconds, reading %.1f MB\n",
+           intersections, (int)visitor.m_partial.size(), seconds, megabytes + pages * kPage * sizeof(AABT) / (1024.f * 1024.f));
+  }
+  return 0;
+}
@@ -0,0 +1,684 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <time.h>
+#include <float.h>
+#include <math.h>
+#include <immintrin.h>
+
+struct Clock
+{
+  const clock_t m_start;
+  Clock() : m_start(clock())
+  {
+  }
+  float seconds() const
+  {
+    const clock_t end = clock();
+    const float seconds = ((float)(end - m_start)) / CLOCKS_PER_SEC;
+    return seconds;
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+// The SAH weighs each child by how likely a query is to reach it. For an AABO, two things
+// decide that. The up test is paid by every child of a node that is entered, and passes
+// about in proportion to the area of the up tetrahedron, whose size is -(minA+minB+minC+minD)
+// since A+B+C+D is zero everywhere. The down test is paid only by children that pass, and
+// a child is entered about in proportion to the AABO's own area, measured like an AABB's
+// xy+yz+zx, as the sum of the products of its extents along every pair of the four axes.
+const float kUpCost = 1.f;     // a 4-plane test on the up column, which is streaming in anyway
+const float kDownCost = 2.f;   // the same test, but on a line of the down column fetched for it
+const float kObjectCost = 1.2f; // an object in a leaf: an up test, and the occasional down test
+
+const int kBins = 16;
+const int kLeafMax = 8;
+
+float UpArea(const AABT mini)
+{
+  const float size = -(mini.a + mini.b + mini.c + mini.d);
+  return size * size;
+}
+
+float OctahedronArea(const AABT mini, const AABT maxi)
+{
+  const float e[4] = {maxi.a - mini.a, maxi.b - mini.b, maxi.c - mini.c, maxi.d - mini.d};
+  return e[0]*e[1] + e[0]*e[2] + e[0]*e[3] + e[1]*e[2] + e[1]*e[3] + e[2]*e[3];
+}
+
+struct Bounds
+{
+  AABT m_min;
+  AABT m_max;
+
+  static Bounds Empty()
+  {
+    Bounds b;
+    b.m_min.abcd = _mm_set1_ps(FLT_MAX);
+    b.m_max.abcd = _mm_set1_ps(-FLT_MAX);
+    return b;
+  }
+
+  void Grow(const AABT mini, const AABT maxi)
+  {
+    m_min.abcd = _mm_min_ps(m_min.abcd, mini.abcd);
+    m_max.abcd = _mm_max_ps(m_max.abcd, maxi.abcd);
+  }
+
+  void Grow(const Bounds& b)
+  {
+    Grow(b.m_min, b.m_max);
+  }
+};
+
+struct Node
+{
+  AABT m_min;
+  AABT m_max;
+  int m_first; // first child if m_count is 0, otherwise first object
+  int m_count;
+};
+
+// What the builder moves around: an object's bounds travel with it through every partition,
+// so each pass over a node reads memory in order instead of chasing object indices.
+struct Ref
+{
+  AABT m_min;
+  AABT m_max;
+  int m_object;
+
+  __m128 Centroid() const
+  {
+    return _mm_mul_ps(_mm_add_ps(m_min.abcd, m_max.abcd), _mm_set1_ps(0.5f));
+  }
+};
+
+struct Bin
+{
+  Bounds m_bounds;
+  int m_count;
+};
+
+struct Pair
+{
+  int m_point;
+  int m_volume;
+
+  bool operator<(const Pair& p) const
+  {
+    return m_point < p.m_point || (m_point == p.m_point && m_volume < p.m_volume);
+  }
+
+  bool operator==(const Pair& p) const
+  {
+    return m_point == p.m_point && m_volume == p.m_volume;
+  }
+};
+
+// The binned SAH hierarchy of aabo_bvh_build.cpp, over the volumes, built on one thread.
+class BVH
+{
+public:
+  std::vector<Node> m_node;
+  std::vector<int> m_object; // object indices, in leaf order
+  std::vector<AABT> m_aabtMin; // the objects' bounds, also in leaf order
+  std::vector<AABT> m_aabtMax;
+
+  BVH(const std::vector<AABT>& aabtMin, const std::vector<AABT>& aabtMax)
+  : m_node(std::max<size_t>(1, 2 * aabtMin.size())), m_object(aabtMin.size()), m_aabtMin(aabtMin.size()), m_aabtMax(aabtMin.size())
+  , m_ref(aabtMin.size()), m_nodes(1)
+  {
+    const int objects = aabtMin.size();
+    Bounds root = Bounds::Empty();
+    for(int o = 0; o < objects; ++o)
+    {
+      m_ref[o].m_min = aabtMin[o];
+      m_ref[o].m_max = aabtMax[o];
+      m_ref[o].m_object = o;
+      root.Grow(aabtMin[o], aabtMax[o]);
+    }
+    m_node[0].m_min = root.m_min;
+    m_node[0].m_max = root.m_max;
+    Build(0, 0, objects);
+    m_node.resize(m_nodes);
+
+    for(int o = 0; o < objects; ++o)
+    {
+      m_object[o] = m_ref[o].m_object;
+      m_aabtMin[o] = m_ref[o].m_min;
+      m_aabtMax[o] = m_ref[o].m_max;
+    }
+    std::vector<Ref>().swap(m_ref);
+  }
+
+  // Appends every volume that contains the point, given in ABCD. The traversal stack is the
+  // caller's, so it grows to whatever depth the tree has once, not once per point.
+  void Locate(const float4 point, int index, std::vector<int>* stack, std::vector<Pair>* pairs) const
+  {
+    stack->assign(1, 0);
+    while(!stack->empty())
+    {
+      const Node& node = m_node[stack->back()];
+      stack->pop_back();
+      if(!(node.m_min <= point && point <= node.m_max))
+        continue;
+      if(node.m_count)
+      {
+        for(int t = node.m_first; t < node.m_first + node.m_count; ++t)
+          if(m_aabtMin[t] <= point && point <= m_aabtMax[t])
+          {
+            const Pair pair = {index, m_object[t]};
+            pairs->push_back(pair);
+          }
+      }
+      else
+      {
+        stack->push_back(node.m_first + 1);
+        stack->push_back(node.m_first);
+      }
+    }
+  }
+
+private:
+  std::vector<Ref> m_ref;
+  int m_nodes;
+
+  // The bin of a centroid along each of the four axes.
+  static __m128i Slots(const __m128 centroid, const AABT cmin, const AABT scale, int bins)
+  {
+    const __m128i slot = _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(centroid, cmin.abcd), scale.abcd));
+    return _mm_min_epi32(_mm_max_epi32(slot, _mm_setzero_si128()), _mm_set1_epi32(bins - 1));
+  }
+
+  void CentroidBounds(int first, int end, AABT* cmin, AABT* cmax) const
+  {
+    cmin->abcd = _mm_set1_ps(FLT_MAX);
+    cmax->abcd = _mm_set1_ps(-FLT_MAX);
+    for(int i = first; i < end; ++i)
+    {
+      cmin->abcd = _mm_min_ps(cmin->abcd, m_ref[i].Centroid());
+      cmax->abcd = _mm_max_ps(cmax->abcd, m_ref[i].Centroid());
+    }
+  }
+
+  // Fills one row of bins per axis with the objects in [first, end). Four bins take every
+  // object, so while filling, a bin keeps its min and its negated max in one 8-wide register
+  // and grows with a single min.
+  void Fill(int first, int end, const AABT cmin, const AABT scale, int bins, Bin bin[4][kBins]) const
+  {
+    const __m256 negateMax = _mm256_setr_ps(0.f, 0.f, 0.f, 0.f, -0.f, -0.f, -0.f, -0.f);
+    __m256 bounds[4][kBins];
+    int count[4][kBins];
+    for(int axis = 0; axis < 4; ++axis)
+      for(int b = 0; b < bins; ++b)
+      {
+        bounds[axis][b] = _mm256_set1_ps(FLT_MAX);
+        count[axis][b] = 0;
+      }
+    for(int i = first; i < end; ++i)
+    {
+      const Ref& ref = m_ref[i];
+      const __m256 r = _mm256_xor_ps(_mm256_loadu_ps((const float*)&ref.m_min), negateMax);
+      int s[4];
+      _mm_storeu_si128((__m128i*)s, Slots(ref.Centroid(), cmin, scale, bins));
+      for(int axis = 0; axis < 4; ++axis)
+      {
+        bounds[axis][s[axis]] = _mm256_min_ps(bounds[axis][s[axis]], r);
+        ++count[axis][s[axis]];
+      }
+    }
+    for(int axis = 0; axis < 4; ++axis)
+      for(int b = 0; b < bins; ++b)
+      {
+        const __m256 bb = _mm256_xor_ps(bounds[axis][b], negateMax);
+        bin[axis][b].m_bounds.m_min.abcd = _mm256_castps256_ps128(bb);
+        bin[axis][b].m_bounds.m_max.abcd = _mm256_extractf128_ps(bb, 1);
+        bin[axis][b].m_count = count[axis][b];
+      }
+  }
+
+  void Leaf(int index, int first, int end)
+  {
+    m_node[index].m_first = first;
+    m_node[index].m_count = end - first;
+  }
+
+  void Build(int index, int first, int end)
+  {
+    const int count = end - first;
+    Node& node = m_node[index];
+    if(count <= 2)
+    {
+      Leaf(index, first, end);
+      return;
+    }
+
+    AABT cmin, cmax;
+    CentroidBounds(first, end, &cmin, &cmax);
+    // a small node gets fewer bins, since the sweep over them costs as much as the binning
+    const int bins = std::min(kBins, std::max(4, count / 4));
+    AABT scale;
+    scale.abcd = _mm_div_ps(_mm_set1_ps(bins * 0.9999f), _mm_max_ps(_mm_sub_ps(cmax.abcd, cmin.abcd), _mm_set1_ps(1e-20f)));
+
+    Bin bin[4][kBins];
+    Fill(first, end, cmin, scale, bins, bin);
+
+    // sweep each axis from both ends for the cheapest split
+    const float upArea = UpArea(node.m_min);
+    const float octahedronArea = OctahedronArea(node.m_min, node.m_max);
+    float bestCost = count * kObjectCost;
+    int bestAxis = -1, bestSplit = 0;
+    Bounds bestLeft, bestRight;
+    for(int axis = 0; axis < 4; ++axis)
+    {
+      Bounds right[kBins];
+      int rightCount[kBins];
+      Bounds r = Bounds::Empty();
+      int n = 0;
+      for(int b = bins - 1; b > 0; --b)
+      {
+        r.Grow(bin[axis][b].m_bounds);
+        n += bin[axis][b].m_count;
+        right[b] = r;
+        rightCount[b] = n;
+      }
+      Bounds l = Bounds::Empty();
+      n = 0;
+      for(int split = 1; split < bins; ++split)
+      {
+        l.Grow(bin[axis][split - 1].m_bounds);
+        n += bin[axis][split - 1].m_count;
+        if(n == 0 || rightCount[split] == 0)
+          continue;
+        float cost = 2.f * kUpCost;
+        cost += (UpArea(l.m_min) / upArea) * kDownCost + (OctahedronArea(l.m_min, l.m_max) / octahedronArea) * n * kObjectCost;
+        cost += (UpArea(right[split].m_min) / upArea) * kDownCost + (OctahedronArea(right[split].m_min, right[split].m_max) / octahedronArea) * rightCount[split] * kObjectCost;
+        if(cost < bestCost)
+        {
+          bestCost = cost;
+          bestAxis = axis;
+          bestSplit = split;
+          bestLeft = l;
+          bestRight = right[split];
+        }
+      }
+    }
+
+    int middle;
+    if(bestAxis >= 0)
+    {
+      middle = std::partition(m_ref.begin() + first, m_ref.begin() + end, [&](const Ref& ref)
+      {
+        int s[4];
+        _mm_storeu_si128((__m128i*)s, Slots(ref.Centroid(), cmin, scale, bins));
+        return s[bestAxis] < bestSplit;
+      }) - m_ref.begin();
+    }
+    else if(count <= kLeafMax)
+    {
+      Leaf(index, first, end);
+      return;
+    }
+    else
+    {
+      // no split beats a leaf, or every centroid is in the same place, but the leaf is
+      // too big: split at the median of the longest centroid axis
+      const float e[4] = {cmax.a - cmin.a, cmax.b - cmin.b, cmax.c - cmin.c, cmax.d - cmin.d};
+      const int axis = std::max_element(e, e + 4) - e;
+      middle = first + count / 2;
+      std::nth_element(m_ref.begin() + first, m_ref.begin() + middle, m_ref.begin() + end, [&](const Ref& a, const Ref& b)
+      {
+        float4 ca, cb;
+        ca.abcd = a.Centroid();
+        cb.abcd = b.Centroid();
+        return ((const float*)&ca)[axis] < ((const float*)&cb)[axis];
+      });
+      bestLeft = bestRight = Bounds::Empty();
+      for(int i = first; i < middle; ++i)
+        bestLeft.Grow(m_ref[i].m_min, m_ref[i].m_max);
+      for(int i = middle; i < end; ++i)
+        bestRight.Grow(m_ref[i].m_min, m_ref[i].m_max);
+    }
+
+    const int child = m_nodes;
+    m_nodes += 2;
+    node.m_first = child;
+    node.m_count = 0;
+    m_node[child].m_min = bestLeft.m_min;
+    m_node[child].m_max = bestLeft.m_max;
+    m_node[child + 1].m_min = bestRight.m_min;
+    m_node[child + 1].m_max = bestRight.m_max;
+
+    Build(child, first, middle);
+    Build(child + 1, middle, end);
+  }
+};
+
+// A point is an AABO whose min and max are the same, so it needs converting once, and a
+// volume holds it if the point is over the volume's up side and under its down side.
+// Points go to ABCD two to an AVX register, as three multiply-adds of the rows of abcdInXyz.
+void ToAbcd(const float3* xyz, int points, float4* abcd)
+{
+  const __m256 x = _mm256_setr_ps(abcdInXyz[0].x, abcdInXyz[1].x, abcdInXyz[2].x, abcdInXyz[3].x, abcdInXyz[0].x, abcdInXyz[1].x, abcdInXyz[2].x, abcdInXyz[3].x);
+  const __m256 y = _mm256_setr_ps(abcdInXyz[0].y, abcdInXyz[1].y, abcdInXyz[2].y, abcdInXyz[3].y, abcdInXyz[0].y, abcdInXyz[1].y, abcdInXyz[2].y, abcdInXyz[3].y);
+  const __m256 z = _mm256_setr_ps(abcdInXyz[0].z, abcdInXyz[1].z, abcdInXyz[2].z, abcdInXyz[3].z, abcdInXyz[0].z, abcdInXyz[1].z, abcdInXyz[2].z, abcdInXyz[3].z);
+  int p = 0;
+  for(; p + 2 <= points; p += 2)
+  {
+    const __m256 px = _mm256_setr_m128(_mm_set1_ps(xyz[p].x), _mm_set1_ps(xyz[p + 1].x));
+    const __m256 py = _mm256_setr_m128(_mm_set1_ps(xyz[p].y), _mm_set1_ps(xyz[p + 1].y));
+    const __m256 pz = _mm256_setr_m128(_mm_set1_ps(xyz[p].z), _mm_set1_ps(xyz[p + 1].z));
+    _mm256_storeu_ps((float*)&abcd[p], _mm256_fmadd_ps(pz, z, _mm256_fmadd_ps(py, y, _mm256_mul_ps(px, x))));
+  }
+  for(; p < points; ++p)
+    abcd[p] = xyzToAbcd(xyz[p]);
+}
+
+// The flat volumes, in SoA groups of kLanes as in aabo_multi_probe.cpp, so a point is tested
+// against a whole group with four compares for the up sides, and four more for the down
+// sides only if some volume's up side holds it. Lanes past the last volume are empty.
+#if defined(__AVX512F__)
+const int kLanes = 16;
+#else
+const int kLanes = 8;
+#endif
+
+struct alignas(64) VolumeGroup
+{
+  float m_min[4][kLanes];
+  float m_max[4][kLanes];
+};
+
+std::vector<VolumeGroup> Transpose(const AABT* volumeMin, const AABT* volumeMax, int volumes)
+{
+  std::vector<VolumeGroup> group((volumes + kLanes - 1) / kLanes);
+  for(int g = 0; g < group.size(); ++g)
+    for(int l = 0; l < kLanes; ++l)
+    {
+      const int v = g * kLanes + l;
+      const float4 mini = v < volumes ? volumeMin[v] : float4{{FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX}};
+      const float4 maxi = v < volumes ? volumeMax[v] : float4{{-FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX}};
+      const float mins[4] = {mini.a, mini.b, mini.c, mini.d};
+      const float maxs[4] = {maxi.a, maxi.b, maxi.c, maxi.d};
+      for(int axis = 0; axis < 4; ++axis)
+      {
+        group[g].m_min[axis][l] = mins[axis];
+        group[g].m_max[axis][l] = maxs[axis];
+      }
+    }
+  return group;
+}
+
+// One bit per volume of the group that holds the point.
+#if defined(__AVX512F__)
+unsigned Contains(const VolumeGroup& group, const float4 point)
+{
+  __mmask16 up = _mm512_cmp_ps_mask(_mm512_load_ps(group.m_min[0]), _mm512_set1_ps(point.a), _CMP_LE_OQ);
+  up = _mm512_mask_cmp_ps_mask(up, _mm512_load_ps(group.m_min[1]), _mm512_set1_ps(point.b), _CMP_LE_OQ);
+  up = _mm512_mask_cmp_ps_mask(up, _mm512_load_ps(group.m_min[2]), _mm512_set1_ps(point.c), _CMP_LE_OQ);
+  up = _mm512_mask_cmp_ps_mask(up, _mm512_load_ps(group.m_min[3]), _mm512_set1_ps(point.d), _CMP_LE_OQ);
+  if(!up)
+    return 0;
+  __mmask16 down = _mm512_mask_cmp_ps_mask(up, _mm512_set1_ps(point.a), _mm512_load_ps(group.m_max[0]), _CMP_LE_OQ);
+  down = _mm512_mask_cmp_ps_mask(down, _mm512_set1_ps(point.b), _mm512_load_ps(group.m_max[1]), _CMP_LE_OQ);
+  down = _mm512_mask_cmp_ps_mask(down, _mm512_set1_ps(point.c), _mm512_load_ps(group.m_max[2]), _CMP_LE_OQ);
+  down = _mm512_mask_cmp_ps_mask(down, _mm512_set1_ps(point.d), _mm512_load_ps(group.m_max[3]), _CMP_LE_OQ);
+  return down;
+}
+#elif defined(__AVX__)
+unsigned Contains(const VolumeGroup& group, const float4 point)
+{
+  __m256 up = _mm256_cmp_ps(_mm256_load_ps(group.m_min[0]), _mm256_set1_ps(point.a), _CMP_LE_OQ);
+  up = _mm256_and_ps(up, _mm256_cmp_ps(_mm256_load_ps(group.m_min[1]), _mm256_set1_ps(point.b), _CMP_LE_OQ));
+  up = _mm256_and_ps(up, _mm256_cmp_ps(_mm256_load_ps(group.m_min[2]), _mm256_set1_ps(point.c), _CMP_LE_OQ));
+  up = _mm256_and_ps(up, _mm256_cmp_ps(_mm256_load_ps(group.m_min[3]), _mm256_set1_ps(point.d), _CMP_LE_OQ));
+  if(!_mm256_movemask_ps(up))
+    return 0;
+  __m256 down = _mm256_and_ps(up, _mm256_cmp_ps(_mm256_set1_ps(point.a), _mm256_load_ps(group.m_max[0]), _CMP_LE_OQ));
+  down = _mm256_and_ps(down, _mm256_cmp_ps(_mm256_set1_ps(point.b), _mm256_load_ps(group.m_max[1]), _CMP_LE_OQ));
+  down = _mm256_and_ps(down, _mm256_cmp_ps(_mm256_set1_ps(point.c), _mm256_load_ps(group.m_max[2]), _CMP_LE_OQ));
+  down = _mm256_and_ps(down, _mm256_cmp_ps(_mm256_set1_ps(point.d), _mm256_load_ps(group.m_max[3]), _CMP_LE_OQ));
+  return _mm256_movemask_ps(down);
+}
+#else
+unsigned Contains(const VolumeGroup& group, const float4 point)
+{
+  unsigned volumes = 0;
+  for(int l = 0; l < kLanes; ++l)
+  {
+    const bool up = group.m_min[0][l] <= point.a && group.m_min[1][l] <= point.b && group.m_min[2][l] <= point.c && group.m_min[3][l] <= point.d;
+    const bool down = point.a <= group.m_max[0][l] && point.b <= group.m_max[1][l] && point.c <= group.m_max[2][l] && point.d <= group.m_max[3][l];
+    volumes |= (up && down) << l;
+  }
+  return volumes;
+}
+#endif
+
+// Every point against every volume. The volumes are the inner loop, since there are fewer
+// of them and they stay in cache while the points stream past once.
+void Locate(const float4* point, int points, const std::vector<VolumeGroup>& group, std::vector<Pair>* pairs)
+{
+  for(int p = 0; p < points; ++p)
+  {
+    const float4 abcd = point[p];
+    for(int g = 0; g < group.size(); ++g)
+    {
+      unsigned volumes = Contains(group[g], abcd);
+      while(volumes)
+      {
+        const Pair pair = {p, g * kLanes + __builtin_ctz(volumes)};
+        pairs->push_back(pair);
+        volumes &= volumes - 1;
+      }
+    }
+  }
+}
+
+void Locate(const BVH& bvh, const float4* point, int points, std::vector<Pair>* pairs)
+{
+  std::vector<int> stack;
+  for(int p = 0; p < points; ++p)
+    bvh.Locate(point[p], p, &stack, pairs);
+}
+
+int main(int argc, char* argv[])
+{
+  // zones a few units across, and points scattered through the same world
+  const int kMeshes = 10;
+  Mesh mesh[kMeshes];
+  for(int m = 0; m < kMeshes; ++m)
+    mesh[m].Generate(100, random(1.f, 4.f));
+
+  const int kVolumes = 4096;
+  const int kPoints = 1000000;
+
+  std::vector<AABT> volumeMin(kVolumes);
+  std::vector<AABT> volumeMax(kVolumes);
+  for(int v = 0; v < kVolumes; ++v)
+  {
+    Object volume;
+    volume.m_mesh = &mesh[rand() % kMeshes];
+    volume.m_position.x = random(-50.f, 50.f);
+    volume.m_position.y = random(-50.f, 50.f);
+    volume.m_position.z = random(-50.f, 50.f);
+    volume.CalculateAABT(&volumeMin[v], &volumeMax[v]);
+  }
+
+  std::vector<float3> xyz(kPoints);
+  for(int p = 0; p < kPoints; ++p)
+  {
+    xyz[p].x = random(-50.f, 50.f);
+    xyz[p].y = random(-50.f, 50.f);
+    xyz[p].z = random(-50.f, 50.f);
+  }
+
+  std::vector<float4> abcd(kPoints);
+  {
+    const Clock clock;
+    for(int p = 0; p < kPoints; ++p)
+      abcd[p] = xyzToAbcd(xyz[p]);
+    const float seconds = clock.seconds();
+    printf("xyzToAbcd converted %d points in %f seconds\n", kPoints, seconds);
+  }
+  {
+    const Clock clock;
+    ToAbcd(xyz.data(), kPoints, abcd.data());
+    const float seconds = clock.seconds();
+    printf("SIMD converted %d points in %f seconds\n", kPoints, seconds);
+  }
+
+  std::vector<Pair> boxes;
+  {
+    // the overlap test of aabo.cpp, with each point as an AABO of its own
+    const Clock clock;
+    for(int p = 0; p < kPoints; ++p)
+    {
+      const AABT probeMin = abcd[p];
+      const AABT probeMax = abcd[p];
+      for(int v = 0; v < kVolumes; ++v)
+      {
+        const AABT targetMin = volumeMin[v];
+        if(targetMin <= probeMax)
+        {
+          const AABT targetMax = volumeMax[v];
+          if(probeMin <= targetMax)
+          {
+            const Pair pair = {p, v};
+            boxes.push_back(pair);
+          }
+        }
+      }
+    }
+    const float seconds = clock.seconds();
+    printf("AABO overlap per point reported %d pairs in %f seconds\n", (int)boxes.size(), seconds);
+  }
+
+  std::vector<Pair> flat;
+  {
+    const Clock clock;
+    Locate(abcd.data(), kPoints, Transpose(volumeMin.data(), volumeMax.data(), kVolumes), &flat);
+    const float seconds = clock.seconds();
+    printf("Point location, flat, reported %d pairs in %f seconds%s\n", (int)flat.size(), seconds, flat == boxes ? "" : ", DISAGREES WITH THE OVERLAP TEST");
+  }
+
+  std::vector<Pair> tree;
+  {
+    const Clock build;
+    const BVH bvh(volumeMin, volumeMax);
+    const float buildSeconds = build.seconds();
+    const Clock clock;
+    Locate(bvh, abcd.data(), kPoints, &tree);
+    const float seconds = clock.seconds();
+    std::sort(tree.begin(), tree.end());
+    printf("Point location, BVH built in %f seconds, reported %d pairs in %f seconds%s\n", buildSeconds, (int)tree.size(), seconds,
+           tree == boxes ? "" : ", DISAGREES WITH THE OVERLAP TEST");
+  }
+  return 0;
+}
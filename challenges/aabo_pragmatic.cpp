@@ -0,0 +1,363 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include <immintrin.h>
+
+struct Clock
+{
+  const clock_t m_start;
+  Clock() : m_start(clock())
+  {
+  }
+  float seconds() const
+  {
+    const clock_t end = clock();
+    const float seconds = ((float)(end - m_start)) / CLOCKS_PER_SEC;
+    return seconds;
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+float3 min(const float3 a, const float3 b)
+{
+  float3 c = {std::min(a.x,b.x), std::min(a.y,b.y), std::min(a.z,b.z)};
+  return c;
+}
+
+float3 max(const float3 a, const float3 b)
+{
+  float3 c = {std::max(a.x,b.x), std::max(a.y,b.y), std::max(a.z,b.z)};
+  return c;
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABB(float3* mini, float3* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyz;
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      *mini = min(*mini, xyz);
+      *maxi = max(*maxi, xyz);
+    }
+  }
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+// The pragmatic axes of the README, in 3D: A=X, B=Y, C=Z and D=-(X+Y+Z). Built from the
+// vertices, the diagonal slab is bounded by the extremes of x+y+z itself rather than by
+// the corners of the AABB, so it rejects things the AABB can't. Only adds, no multiplies.
+//
+//   {minX, minY, minZ, -max(X+Y+Z)}
+//   {maxX, maxY, maxZ, -min(X+Y+Z)}
+void CalculatePragmatic(const Object& object, float4* mini, float4* maxi)
+{
+  const Mesh& mesh = *object.m_mesh;
+  float3 lo = object.m_position + mesh.m_point[0];
+  float3 hi = lo;
+  float sumLo = lo.x + lo.y + lo.z;
+  float sumHi = sumLo;
+  for(int p = 1; p < mesh.m_point.size(); ++p)
+  {
+    const float3 xyz = object.m_position + mesh.m_point[p];
+    const float sum = xyz.x + xyz.y + xyz.z;
+    lo = min(lo, xyz);
+    hi = max(hi, xyz);
+    sumLo = std::min(sumLo, sum);
+    sumHi = std::max(sumHi, sum);
+  }
+  mini->a = lo.x;
+  mini->b = lo.y;
+  mini->c = lo.z;
+  mini->d = -sumHi;
+  maxi->a = hi.x;
+  maxi->b = hi.y;
+  maxi->c = hi.z;
+  maxi->d = -sumLo;
+}
+
+// A query that is only an AABB, say a region of the world, goes into the same form with
+// adds, and then its diagonal slab is exactly the AABB's own.
+void PragmaticFromAABB(const float3 aabbMin, const float3 aabbMax, float4* mini, float4* maxi)
+{
+  mini->a = aabbMin.x;
+  mini->b = aabbMin.y;
+  mini->c = aabbMin.z;
+  mini->d = -(aabbMax.x + aabbMax.y + aabbMax.z);
+  maxi->a = aabbMax.x;
+  maxi->b = aabbMax.y;
+  maxi->c = aabbMax.z;
+  maxi->d = -(aabbMin.x + aabbMin.y + aabbMin.z);
+}
+
+// Unlike the 7-sided AABB, the down side's diagonal is not implied by its other three planes,
+// so both sides test all four lanes, which is the same kernel as the AABO's.
+int Intersections(const float4* pragmaticMin, const float4* pragmaticMax, int objects, const float4 queryMin, const float4 queryMax, int* partials)
+{
+  int intersections = 0;
+  for(int t = 0; t < objects; ++t)
+  {
+    const float4 objectMin = pragmaticMin[t];
+    if(objectMin <= queryMax)
+    {
+      ++*partials;
+      const float4 objectMax = pragmaticMax[t];
+      if(queryMin <= objectMax)
+        ++intersections;
+    }
+  }
+  return intersections;
+}
+
+int main(int argc, char* argv[])
+{
+  const int kMeshes = 100;
+  Mesh mesh[kMeshes];
+  for(int m = 0; m < kMeshes; ++m)
+    mesh[m].Generate(50, 1.f);
+
+  const int kTests = 100;
+
+  const int kObjects = 10000000;
+  Object* objects = new Object[kObjects];
+  for(int o = 0; o < kObjects; ++o)
+  {
+    objects[o].m_mesh = &mesh[rand() % kMeshes];
+    objects[o].m_position.x = random(-50.f, 50.f);
+    objects[o].m_position.y = random(-50.f, 50.f);
+    objects[o].m_position.z = random(-50.f, 50.f);
+  }
+
+  float3* aabbMin = new float3[kObjects];
+  float3* aabbMax = new float3[kObjects];
+  float aabbBuild;
+  {
+    const Clock clock;
+    for(int a = 0; a < kObjects; ++a)
+      objects[a].CalculateAABB(&aabbMin[a], &aabbMax[a]);
+    aabbBuild = clock.seconds();
+  }
+
+  float4* sevenMin = new float4[kObjects];
+  float4* sevenMax = new float4[kObjects];
+  float sevenBuild;
+  {
+    const Clock clock;
+    for(int a = 0; a < kObjects; ++a)
+      PragmaticFromAABB(aabbMin[a], aabbMax[a], &sevenMin[a], &sevenMax[a]);
+    sevenBuild = aabbBuild + clock.seconds();
+  }
+
+  float4* pragmaticMin = new float4[kObjects];
+  float4* pragmaticMax = new float4[kObjects];
+  float pragmaticBuild;
+  {
+    const Clock clock;
+    for(int a = 0; a < kObjects; ++a)
+      CalculatePragmatic(objects[a], &pragmaticMin[a], &pragmaticMax[a]);
+    pragmaticBuild = clock.seconds();
+  }
+
+  float4* aabtMin = new float4[kObjects];
+  float4* aabtMax = new float4[kObjects];
+  float aabtBuild;
+  {
+    const Clock clock;
+    for(int a = 0; a < kObjects; ++a)
+      objects[a].CalculateAABT(&aabtMin[a], &aabtMax[a]);
+    aabtBuild = clock.seconds();
+  }
+
+  const char *title = "%22s | %7s | %9s | %7s | %7s\n";
+  printf(title, "Bounding Volume", "build", "partial", "accepts", "seconds");
+  printf(title, "", "seconds", "accepts", "", "");
+  printf("------------------------------------------------------------------\n");
+
+  const char *format = "%22s | %7.4f | %9d | %7d | %3.4f\n";
+
+  {
+    const Clock clock;
+    int partials = 0;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+    {
+      const float3 queryMin = aabbMin[test];
+      const float3 queryMax = aabbMax[test];
+      for(int t = 0; t < kObjects; ++t)
+      {
+        const float3 objectMin = aabbMin[t];
+        if(objectMin.x <= queryMax.x
+        && objectMin.y <= queryMax.y
+        && objectMin.z <= queryMax.z)
+        {
+          ++partials;
+          const float3 objectMax = aabbMax[t];
+          if(queryMin.x <= objectMax.x
+          && queryMin.y <= objectMax.y
+          && queryMin.z <= objectMax.z)
+            ++intersections;
+        }
+      }
+    }
+    const float seconds = clock.seconds();
+
+    printf(format, "AABB MIN,MAX", aabbBuild, partials, intersections, seconds);
+  }
+
+  {
+    const Clock clock;
+    int partials = 0;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+      intersections += Intersections(sevenMin, sevenMax, kObjects, sevenMin[test], sevenMax[test], &partials);
+    const float seconds = clock.seconds();
+
+    printf(format, "7-Sided AABB", sevenBuild, partials, intersections, seconds);
+  }
+
+  {
+    const Clock clock;
+    int partials = 0;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+      intersections += Intersections(pragmaticMin, pragmaticMax, kObjects, pragmaticMin[test], pragmaticMax[test], &partials);
+    const float seconds = clock.seconds();
+
+    printf(format, "Pragmatic AABO", pragmaticBuild, partials, intersections, seconds);
+  }
+
+  {
+    // AABB queries against pragmatic objects: the query loses its own diagonal,
+    // but the objects keep theirs
+    const Clock clock;
+    int partials = 0;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+    {
+      float4 queryMin, queryMax;
+      PragmaticFromAABB(aabbMin[test], aabbMax[test], &queryMin, &queryMax);
+      intersections += Intersections(pragmaticMin, pragmaticMax, kObjects, queryMin, queryMax, &partials);
+    }
+    const float seconds = clock.seconds();
+
+    printf(format, "Pragmatic, AABB query", pragmaticBuild, partials, intersections, seconds);
+  }
+
+  {
+    const Clock clock;
+    int partials = 0;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+      intersections += Intersections(aabtMin, aabtMax, kObjects, aabtMin[test], aabtMax[test], &partials);
+    const float seconds = clock.seconds();
+
+    printf(format, "AABO", aabtBuild, partials, intersections, seconds);
+  }
+  return 0;
+}
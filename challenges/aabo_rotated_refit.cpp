@@ -0,0 +1,502 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include <immintrin.h>
+
+struct Clock
+{
+  const clock_t m_start;
+  Clock() : m_start(clock())
+  {
+  }
+  float seconds() const
+  {
+    const clock_t end = clock();
+    const float seconds = ((float)(end - m_start)) / CLOCKS_PER_SEC;
+    return seconds;
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+float3 operator-(const float3 a, const float3 b)
+{
+  float3 c = {a.x-b.x, a.y-b.y, a.z-b.z};
+  return c;
+}
+
+float3 operator-(const float3 a)
+{
+  float3 c = {-a.x, -a.y, -a.z};
+  return c;
+}
+
+float3 operator*(const float3 a, const float b)
+{
+  float3 c = {a.x*b, a.y*b, a.z*b};
+  return c;
+}
+
+float3 cross(const float3 a, const float3 b)
+{
+  float3 c = {a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x};
+  return c;
+}
+
+struct float3x3
+{
+  float3 m_row[3];
+
+  float3 operator*(const float3 v) const
+  {
+    float3 c = {dot(m_row[0], v), dot(m_row[1], v), dot(m_row[2], v)};
+    return c;
+  }
+
+  // the transpose times v: a direction in the rotated frame, taken back to the mesh's frame
+  float3 Inverse(const float3 v) const
+  {
+    return m_row[0] * v.x + m_row[1] * v.y + m_row[2] * v.z;
+  }
+};
+
+struct Quaternion
+{
+  float x, y, z, w;
+
+  Quaternion operator*(const Quaternion& q) const
+  {
+    Quaternion c = {w*q.x + x*q.w + y*q.z - z*q.y, w*q.y - x*q.z + y*q.w + z*q.x, w*q.z + x*q.y - y*q.x + z*q.w, w*q.w - x*q.x - y*q.y - z*q.z};
+    return c;
+  }
+
+  float3x3 Matrix() const
+  {
+    float3x3 m = {{{1 - 2*(y*y + z*z), 2*(x*y - z*w), 2*(x*z + y*w)},
+                   {2*(x*y + z*w), 1 - 2*(x*x + z*z), 2*(y*z - x*w)},
+                   {2*(x*z - y*w), 2*(y*z + x*w), 1 - 2*(x*x + y*y)}}};
+    return m;
+  }
+};
+
+Quaternion RandomRotation(float maxAngle)
+{
+  float3 axis;
+  do
+  {
+    axis.x = random(-1.f, 1.f);
+    axis.y = random(-1.f, 1.f);
+    axis.z = random(-1.f, 1.f);
+  } while(length(axis) > 1.f || length(axis) < 0.01f);
+  axis = axis * (1.f / length(axis));
+  const float half = random(-maxAngle, maxAngle) * 0.5f;
+  const Quaternion q = {axis.x * sinf(half), axis.y * sinf(half), axis.z * sinf(half), cosf(half)};
+  return q;
+}
+
+// The convex hull of a mesh, for finding its extreme point along any direction without
+// looking at the points inside. Built incrementally: each point outside the hull so far
+// removes the faces it can see, and joins the edges around them to itself.
+class ConvexHull
+{
+public:
+  std::vector<float3> m_vertex;
+  // Each vertex's neighbours along hull edges, in SoA blocks of 8 for testing at once.
+  // A block is padded with the vertex itself, which is never better than itself.
+  std::vector<int> m_firstBlock;
+  std::vector<int> m_blocks;
+  std::vector<float> m_x;
+  std::vector<float> m_y;
+  std::vector<float> m_z;
+  std::vector<int> m_index;
+
+  ConvexHull(const Mesh& mesh)
+  {
+    const std::vector<float3>& point = mesh.m_point;
+    std::vector<Face> face;
+    Start(point, &face);
+
+    for(int p = 0; p < point.size(); ++p)
+    {
+      std::vector<std::pair<int, int> > edges;
+      std::vector<Face> kept;
+      for(int f = 0; f < face.size(); ++f)
+        if(dot(face[f].m_normal, point[p]) - face[f].m_offset > m_epsilon)
+          for(int e = 0; e < 3; ++e)
+            edges.push_back(std::make_pair(face[f].m_vertex[e], face[f].m_vertex[(e + 1) % 3]));
+        else
+          kept.push_back(face[f]);
+      if(edges.empty())
+        continue;
+      std::sort(edges.begin(), edges.end());
+      face.swap(kept);
+      for(int e = 0; e < edges.size(); ++e)
+      {
+        // an edge of the visible region whose twin isn't in it is on the horizon
+        const std::pair<int, int> twin(edges[e].second, edges[e].first);
+        if(!std::binary_search(edges.begin(), edges.end(), twin))
+          face.push_back(MakeFace(point, edges[e].first, edges[e].second, p));
+      }
+    }
+
+    // number the hull's vertices, and gather the neighbours of each
+    std::vector<int> number(point.size(), -1);
+    std::vector<std::pair<int, int> > edges;
+    for(int f = 0; f < face.size(); ++f)
+      for(int e = 0; e < 3; ++e)
+      {
+        const int v = face[f].m_vertex[e];
+        if(number[v] < 0)
+        {
+          number[v] = m_vertex.size();
+          m_vertex.push_back(point[v]);
+        }
+      }
+    for(int f = 0; f < face.size(); ++f)
+      for(int e = 0; e < 3; ++e)
+        edges.push_back(std::make_pair(number[face[f].m_vertex[e]], number[face[f].m_vertex[(e + 1) % 3]]));
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    m_firstBlock.resize(m_vertex.size());
+    m_blocks.resize(m_vertex.size());
+    int e = 0;
+    for(int v = 0; v < m_vertex.size(); ++v)
+    {
+      m_firstBlock[v] = m_index.size() / 8;
+      int lane = 0;
+      for(; e < edges.size() && edges[e].first == v; ++e, ++lane)
+        Append(edges[e].second);
+      for(; lane % 8; ++lane)
+        Append(v);
+      m_blocks[v] = m_index.size() / 8 - m_firstBlock[v];
+    }
+  }
+
+  // The vertex furthest along a direction, found by walking from the start vertex to its
+  // best neighbour until none is better. On a convex hull there is no local maximum but
+  // the global one, and from last frame's answer the walk is usually a step or two.
+  int Support(const float3 direction, int start) const
+  {
+    const __m256 dx = _mm256_set1_ps(direction.x);
+    const __m256 dy = _mm256_set1_ps(direction.y);
+    const __m256 dz = _mm256_set1_ps(direction.z);
+    int v = start;
+    float best = dot(m_vertex[v], direction);
+    for(;;)
+    {
+      int next = v;
+      for(int b = m_firstBlock[v]; b < m_firstBlock[v] + m_blocks[v]; ++b)
+      {
+        const __m256 d = _mm256_fmadd_ps(_mm256_loadu_ps(&m_z[b * 8]), dz, _mm256_fmadd_ps(_mm256_loadu_ps(&m_y[b * 8]), dy, _mm256_mul_ps(_mm256_loadu_ps(&m_x[b * 8]), dx)));
+        unsigned better = _mm256_movemask_ps(_mm256_cmp_ps(d, _mm256_set1_ps(best), _CMP_GT_OQ));
+        if(!better)
+          continue;
+        float lane[8];
+        _mm256_storeu_ps(lane, d);
+        for(; better; better &= better - 1)
+        {
+          const int l = __builtin_ctz(better);
+          if(lane[l] > best)
+          {
+            best = lane[l];
+            next = m_index[b * 8 + l];
+          }
+        }
+      }
+      if(next == v)
+        return v;
+      v = next;
+    }
+  }
+
+private:
+  struct Face
+  {
+    int m_vertex[3]; // counterclockwise seen from outside
+    float3 m_normal;
+    float m_offset;  // the points of the hull have dot(m_normal, point) <= m_offset
+  };
+
+  float3 m_inside;
+  float m_epsilon;
+
+  Face MakeFace(const std::vector<float3>& point, int a, int b, int c) const
+  {
+    Face f = {{a, b, c}, {0.f, 0.f, 0.f}, 0.f};
+    f.m_normal = cross(point[b] - point[a], point[c] - point[a]);
+    f.m_offset = dot(f.m_normal, point[a]);
+    if(dot(f.m_normal, m_inside) > f.m_offset)
+    {
+      std::swap(f.m_vertex[1], f.m_vertex[2]);
+      f.m_normal = -f.m_normal;
+      f.m_offset = -f.m_offset;
+    }
+    return f;
+  }
+
+  // A first tetrahedron, as big as can be found quickly, and a point inside it.
+  void Start(const std::vector<float3>& point, std::vector<Face>* face)
+  {
+    int v[4] = {0, 0, 0, 0};
+    float furthest = 0.f;
+    for(int p = 0; p < point.size(); ++p)
+      if(length(point[p] - point[0]) > furthest)
+      {
+        furthest = length(point[p] - point[0]);
+        v[1] = p;
+      }
+    float area = 0.f;
+    for(int p = 0; p < point.size(); ++p)
+      if(length(cross(point[v[1]] - point[v[0]], point[p] - point[v[0]])) > area)
+      {
+        area = length(cross(point[v[1]] - point[v[0]], point[p] - point[v[0]]));
+        v[2] = p;
+      }
+    const float3 normal = cross(point[v[1]] - point[v[0]], point[v[2]] - point[v[0]]);
+    float volume = 0.f;
+    for(int p = 0; p < point.size(); ++p)
+      if(fabsf(dot(normal, point[p] - point[v[0]])) > volume)
+      {
+        volume = fabsf(dot(normal, point[p] - point[v[0]]));
+        v[3] = p;
+      }
+    m_inside = (point[v[0]] + point[v[1]] + point[v[2]] + point[v[3]]) * 0.25f;
+    m_epsilon = furthest * furthest * furthest * 1e-6f; // normals go with area, so a plane test goes with volume
+    face->push_back(MakeFace(point, v[0], v[1], v[2]));
+    face->push_back(MakeFace(point, v[0], v[1], v[3]));
+    face->push_back(MakeFace(point, v[0], v[2], v[3]));
+    face->push_back(MakeFace(point, v[1], v[2], v[3]));
+  }
+
+  void Append(int neighbour)
+  {
+    m_x.push_back(m_vertex[neighbour].x);
+    m_y.push_back(m_vertex[neighbour].y);
+    m_z.push_back(m_vertex[neighbour].z);
+    m_index.push_back(neighbour);
+  }
+};
+
+// An object that turns as well as moves.
+struct RotatedObject
+{
+  Mesh* m_mesh;
+  const ConvexHull* m_hull;
+  float3 m_position;
+  float3x3 m_rotation;
+
+  // every point of the mesh, as Object::CalculateAABT
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    *mini = *maxi = xyzToAbcd(m_position + m_rotation * m_mesh->m_point[0]);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float4 abcd = xyzToAbcd(m_position + m_rotation * m_mesh->m_point[p]);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  }
+};
+
+// The AABOs of many rotated objects from their hulls. Each of the four axes is turned into
+// the mesh's frame, and the hull's extreme vertices along it and against it give the eight
+// planes, moved by the position. warm holds eight vertices per object, where the walks
+// start, and gets the ones they end at, so the next refit starts from this one's answers.
+void Refit(const RotatedObject* objects, int count, int* warm, AABT* mini, AABT* maxi)
+{
+  for(int o = 0; o < count; ++o)
+  {
+    const RotatedObject& object = objects[o];
+    const ConvexHull& hull = *object.m_hull;
+    int* start = warm + o * 8;
+    float lo[4], hi[4];
+    for(int axis = 0; axis < 4; ++axis)
+    {
+      const float3 direction = object.m_rotation.Inverse(abcdInXyz[axis]);
+      start[axis] = hull.Support(direction, start[axis]);
+      start[axis + 4] = hull.Support(-direction, start[axis + 4]);
+      hi[axis] = dot(hull.m_vertex[start[axis]], direction);
+      lo[axis] = dot(hull.m_vertex[start[axis + 4]], direction);
+    }
+    const float4 offset = xyzToAbcd(object.m_position);
+    mini[o].abcd = _mm_add_ps(_mm_loadu_ps(lo), offset.abcd);
+    maxi[o].abcd = _mm_add_ps(_mm_loadu_ps(hi), offset.abcd);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  const int kObjects = 1000000;
+  const int kPointCounts[] = {50, 200, 1000};
+  const float kTurn = 0.05f; // radians per frame, at most
+
+  const char *title = "%6s | %6s | %9s | %9s | %9s | %10s\n";
+  printf(title, "mesh", "hull", "all", "hull", "hull", "max");
+  printf(title, "points", "points", "points", "cold", "warm", "difference");
+  printf("-----------------------------------------------------------------\n");
+  for(int c = 0; c < sizeof(kPointCounts) / sizeof(kPointCounts[0]); ++c)
+  {
+    Mesh mesh;
+    mesh.Generate(kPointCounts[c], 1.f);
+    const ConvexHull hull(mesh);
+
+    std::vector<RotatedObject> objects(kObjects);
+    std::vector<Quaternion> orientation(kObjects);
+    for(int o = 0; o < kObjects; ++o)
+    {
+      objects[o].m_mesh = &mesh;
+      objects[o].m_hull = &hull;
+      objects[o].m_position.x = random(-50.f, 50.f);
+      objects[o].m_position.y = random(-50.f, 50.f);
+      objects[o].m_position.z = random(-50.f, 50.f);
+      orientation[o] = RandomRotation(3.14159265f);
+      objects[o].m_rotation = orientation[o].Matrix();
+    }
+
+    std::vector<AABT> pointMin(kObjects), pointMax(kObjects);
+    std::vector<AABT> hullMin(kObjects), hullMax(kObjects);
+    std::vector<int> warm(kObjects * 8, 0);
+    Refit(objects.data(), kObjects, warm.data(), hullMin.data(), hullMax.data()); // the first frame, from vertex 0
+
+    // the next frame: everything turns a little
+    for(int o = 0; o < kObjects; ++o)
+    {
+      orientation[o] = RandomRotation(kTurn) * orientation[o];
+      objects[o].m_rotation = orientation[o].Matrix();
+    }
+
+    const Clock pointClock;
+    for(int o = 0; o < kObjects; ++o)
+      objects[o].CalculateAABT(&pointMin[o], &pointMax[o]);
+    const float pointSeconds = pointClock.seconds();
+
+    std::vector<int> cold(kObjects * 8, 0);
+    const Clock coldClock;
+    Refit(objects.data(), kObjects, cold.data(), hullMin.data(), hullMax.data());
+    const float coldSeconds = coldClock.seconds();
+
+    const Clock warmClock;
+    Refit(objects.data(), kObjects, warm.data(), hullMin.data(), hullMax.data());
+    const float warmSeconds = warmClock.seconds();
+
+    float difference = 0.f;
+    for(int o = 0; o < kObjects; ++o)
+    {
+      const float d[8] = {pointMin[o].a - hullMin[o].a, pointMin[o].b - hullMin[o].b, pointMin[o].c - hullMin[o].c, pointMin[o].d - hullMin[o].d,
+                          pointMax[o].a - hullMax[o].a, pointMax[o].b - hullMax[o].b, pointMax[o].c - hullMax[o].c, pointMax[o].d - hullMax[o].d};
+      for(int i = 0; i < 8; ++i)
+        difference = std::max(difference, fabsf(d[i]));
+    }
+    printf("%6d | %6d | %9.4f | %9.4f | %9.4f | %10.2e\n", kPointCounts[c], (int)hull.m_vertex.size(), pointSeconds, coldSeconds, warmSeconds, difference);
+  }
+  return 0;
+}
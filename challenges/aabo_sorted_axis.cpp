@@ -0,0 +1,408 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include <immintrin.h>
+
+struct Clock
+{
+  const clock_t m_start;
+  Clock() : m_start(clock())
+  {
+  }
+  float seconds() const
+  {
+    const clock_t end = clock();
+    const float seconds = ((float)(end - m_start)) / CLOCKS_PER_SEC;
+    return seconds;
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+// The objects, sorted on the minimum of one ABCD axis. A probe can only intersect an object
+// whose minimum on that axis is <= the probe's maximum, and whose minimum is no further below
+// the probe's minimum than the widest object is wide. So each query binary-searches that range
+// and never touches anything outside it.
+struct SortedOctahedra
+{
+  int m_axis;
+  float m_maxExtent;
+  std::vector<float> m_key;  // m_min[].axis, packed so the binary search touches less memory
+  std::vector<AABT> m_min;
+  std::vector<AABT> m_max;
+  std::vector<int> m_id;     // original index of each sorted object
+  std::vector<int> m_slot;   // sorted position of each original index
+  std::vector<int> m_moved;  // original indices updated since the last sort
+
+  static float Axis(const AABT abcd, int axis)
+  {
+    return (&abcd.a)[axis];
+  }
+
+  // Picks the axis on which the range a typical query scans is the smallest
+  // fraction of the whole spread of the data.
+  static int ChooseAxis(const std::vector<AABT>& aabtMin, const std::vector<AABT>& aabtMax)
+  {
+    int best = 0;
+    float bestFraction = INFINITY;
+    for(int axis = 0; axis < 4; ++axis)
+    {
+      float lo = INFINITY, hi = -INFINITY, widest = 0.f;
+      double total = 0.0;
+      for(int o = 0; o < aabtMin.size(); ++o)
+      {
+        const float mini = Axis(aabtMin[o], axis);
+        const float extent = Axis(aabtMax[o], axis) - mini;
+        lo = std::min(lo, mini);
+        hi = std::max(hi, mini);
+        widest = std::max(widest, extent);
+        total += extent;
+      }
+      const float fraction = (widest + total / aabtMin.size()) / (hi - lo);
+      if(fraction < bestFraction)
+      {
+        bestFraction = fraction;
+        best = axis;
+      }
+    }
+    return best;
+  }
+
+  void Build(const std::vector<AABT>& aabtMin, const std::vector<AABT>& aabtMax)
+  {
+    m_axis = ChooseAxis(aabtMin, aabtMax);
+    std::vector<int> order(aabtMin.size());
+    for(int o = 0; o < order.size(); ++o)
+      order[o] = o;
+    const int axis = m_axis;
+    std::sort(order.begin(), order.end(), [&](int l, int r) { return Axis(aabtMin[l], axis) < Axis(aabtMin[r], axis); });
+    m_key.resize(order.size());
+    m_min.resize(order.size());
+    m_max.resize(order.size());
+    m_id = order;
+    m_slot.resize(order.size());
+    for(int s = 0; s < order.size(); ++s)
+    {
+      m_min[s] = aabtMin[order[s]];
+      m_max[s] = aabtMax[order[s]];
+      m_slot[order[s]] = s;
+    }
+    Finish();
+    m_moved.clear();
+  }
+
+  void Finish()
+  {
+    m_maxExtent = 0.f;
+    for(int s = 0; s < m_min.size(); ++s)
+    {
+      m_key[s] = Axis(m_min[s], m_axis);
+      m_maxExtent = std::max(m_maxExtent, Axis(m_max[s], m_axis) - m_key[s]);
+    }
+  }
+
+  // Changes an object's bounds in place. The order is only restored by Resort(),
+  // so queries must not run in between.
+  void Update(int id, const AABT mini, const AABT maxi)
+  {
+    const int s = m_slot[id];
+    m_min[s] = mini;
+    m_max[s] = maxi;
+    m_moved.push_back(id);
+  }
+
+  // Pulls the moved objects out, sorts just those, and merges them back from the end
+  // in one linear pass. That costs O(n + m log m) instead of sorting all n again.
+  void Resort()
+  {
+    std::vector<char> isMoved(m_id.size(), 0);
+    for(int m = 0; m < m_moved.size(); ++m)
+      isMoved[m_moved[m]] = 1;
+
+    std::vector<int> movedId;
+    std::vector<AABT> movedMin, movedMax;
+    int kept = 0;
+    for(int s = 0; s < m_id.size(); ++s)
+    {
+      if(isMoved[m_id[s]])
+      {
+        movedId.push_back(m_id[s]);
+        movedMin.push_back(m_min[s]);
+        movedMax.push_back(m_max[s]);
+        continue;
+      }
+      m_id[kept] = m_id[s];
+      m_min[kept] = m_min[s];
+      m_max[kept] = m_max[s];
+      ++kept;
+    }
+
+    std::vector<int> order(movedId.size());
+    for(int m = 0; m < order.size(); ++m)
+      order[m] = m;
+    std::sort(order.begin(), order.end(), [&](int l, int r) { return Axis(movedMin[l], m_axis) < Axis(movedMin[r], m_axis); });
+
+    int i = kept - 1;
+    int j = order.size() - 1;
+    for(int s = m_id.size() - 1; j >= 0; --s)
+    {
+      if(i >= 0 && Axis(m_min[i], m_axis) > Axis(movedMin[order[j]], m_axis))
+      {
+        m_id[s] = m_id[i];
+        m_min[s] = m_min[i];
+        m_max[s] = m_max[i];
+        --i;
+      }
+      else
+      {
+        m_id[s] = movedId[order[j]];
+        m_min[s] = movedMin[order[j]];
+        m_max[s] = movedMax[order[j]];
+        --j;
+      }
+    }
+
+    for(int s = 0; s < m_id.size(); ++s)
+      m_slot[m_id[s]] = s;
+    Finish();
+    m_moved.clear();
+  }
+
+  template<typename Visitor> void Query(const AABT probeMin, const AABT probeMax, Visitor& visitor) const
+  {
+    const float lo = Axis(probeMin, m_axis) - m_maxExtent;
+    const float hi = Axis(probeMax, m_axis);
+    const int first = std::lower_bound(m_key.begin(), m_key.end(), lo) - m_key.begin();
+    const int end = std::upper_bound(m_key.begin() + first, m_key.end(), hi) - m_key.begin();
+    for(int t = first; t < end; ++t)
+    {
+      const AABT targetMin = m_min[t];
+      if(targetMin <= probeMax)
+      {
+        const AABT targetMax = m_max[t];
+        if(probeMin <= targetMax)
+          visitor(m_id[t]);
+      }
+    }
+    visitor.m_scanned += end - first;
+  }
+};
+
+struct Counter
+{
+  int m_intersections;
+  long long m_scanned;
+  Counter() : m_intersections(0), m_scanned(0)
+  {
+  }
+  void operator()(int)
+  {
+    ++m_intersections;
+  }
+};
+
+int main(int argc, char* argv[])
+{
+  Mesh mesh;
+  mesh.Generate(100, 1.0f);
+
+  const int kTests = 100;
+
+  const int kObjects = 10000000;
+  std::vector<Object> objects(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    objects[o].m_mesh = &mesh;
+    objects[o].m_position.x = random(-50.f, 50.f);
+    objects[o].m_position.y = random(-50.f, 50.f);
+    objects[o].m_position.z = random(-50.f, 50.f);
+  }
+
+  std::vector<AABT> aabtMin(kObjects);
+  std::vector<AABT> aabtMax(kObjects);
+  for(int a = 0; a < kObjects; ++a)
+    objects[a].CalculateAABT(&aabtMin[a], &aabtMax[a]);
+
+  {
+    const Clock clock;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+    {
+      const AABT probeMin = aabtMin[test];
+      const AABT probeMax = aabtMax[test];
+      for(int t = 0; t < kObjects; ++t)
+      {
+        const AABT targetMin = aabtMin[t];
+        if(targetMin <= probeMax)
+        {
+	  const AABT targetMax = aabtMax[t];
+	  if(probeMin <= targetMax)
+	    ++intersections;
+        }
+      }
+    }
+    const float seconds = clock.seconds();
+
+    printf("AABO SIMD reported %d intersections in %f seconds\n", intersections, seconds);
+  }
+
+  SortedOctahedra sorted;
+  {
+    const Clock clock;
+    sorted.Build(aabtMin, aabtMax);
+    const float seconds = clock.seconds();
+
+    printf("Sorting on axis %c took %f seconds\n", "ABCD"[sorted.m_axis], seconds);
+  }
+
+  {
+    const Clock clock;
+    Counter counter;
+    for(int test = 0; test < kTests; ++test)
+      sorted.Query(aabtMin[test], aabtMax[test], counter);
+    const float seconds = clock.seconds();
+
+    printf("AABO SIMD sorted on %c reported %d intersections in %f seconds, scanning %.2f%% of objects\n",
+           "ABCD"[sorted.m_axis], counter.m_intersections, seconds, 100.f * counter.m_scanned / ((float)kObjects * kTests));
+  }
+
+  {
+    // a frame of small moves for 1% of the objects
+    const int kMoves = kObjects / 100;
+    for(int m = 0; m < kMoves; ++m)
+    {
+      const int o = rand() % kObjects;
+      objects[o].m_position.x += random(-0.1f, 0.1f);
+      objects[o].m_position.y += random(-0.1f, 0.1f);
+      objects[o].m_position.z += random(-0.1f, 0.1f);
+      objects[o].CalculateAABT(&aabtMin[o], &aabtMax[o]);
+      sorted.Update(o, aabtMin[o], aabtMax[o]);
+    }
+
+    const Clock clock;
+    sorted.Resort();
+    const float seconds = clock.seconds();
+
+    Counter counter;
+    for(int test = 0; test < kTests; ++test)
+      sorted.Query(aabtMin[test], aabtMax[test], counter);
+
+    int expected = 0;
+    for(int test = 0; test < kTests; ++test)
+      for(int t = 0; t < kObjects; ++t)
+        if(aabtMin[t] <= aabtMax[test] && aabtMin[test] <= aabtMax[t])
+          ++expected;
+
+    printf("Resorting %d moved objects took %f seconds, then the sorted scan reported %d intersections (expected %d)\n",
+           kMoves, seconds, counter.m_intersections, expected);
+  }
+  return 0;
+}
@@ -0,0 +1,367 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+#include <immintrin.h>
+
+struct Clock
+{
+  const clock_t m_start;
+  Clock() : m_start(clock())
+  {
+  }
+  float seconds() const
+  {
+    const clock_t end = clock();
+    const float seconds = ((float)(end - m_start)) / CLOCKS_PER_SEC;
+    return seconds;
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+float3 operator-(const float3 a, const float3 b)
+{
+  float3 c = {a.x-b.x, a.y-b.y, a.z-b.z};
+  return c;
+}
+
+// The AABO of an object moving in a straight line over a frame. Moving doesn't change its
+// shape, so the sweep's extent along any axis is the start's extent stretched by the
+// motion along that axis, which is the union of the start and end AABOs. No AABO that
+// holds the whole sweep is tighter, since each of its eight planes touches the start or
+// the end. Along axes the object moves away from, only the max grows, and along the
+// others only the min.
+void SweepScalar(const AABT& startMin, const AABT& startMax, const float3 from, const float3 to, AABT* sweptMin, AABT* sweptMax)
+{
+  const float4 delta = xyzToAbcd(to - from);
+  const float4 zero = {0.f, 0.f, 0.f, 0.f};
+  const float4 down = min(delta, zero);
+  const float4 up = max(delta, zero);
+  sweptMin->a = startMin.a + down.a;
+  sweptMin->b = startMin.b + down.b;
+  sweptMin->c = startMin.c + down.c;
+  sweptMin->d = startMin.d + down.d;
+  sweptMax->a = startMax.a + up.a;
+  sweptMax->b = startMax.b + up.b;
+  sweptMax->c = startMax.c + up.c;
+  sweptMax->d = startMax.d + up.d;
+}
+
+// The same for a whole array. The motion goes from XYZ to ABCD as three multiply-adds of
+// the rows of abcdInXyz, two objects to a register.
+void Sweep(const AABT* startMin, const AABT* startMax, const float3* from, const float3* to, int objects, AABT* sweptMin, AABT* sweptMax)
+{
+  const __m256 x = _mm256_setr_ps(abcdInXyz[0].x, abcdInXyz[1].x, abcdInXyz[2].x, abcdInXyz[3].x, abcdInXyz[0].x, abcdInXyz[1].x, abcdInXyz[2].x, abcdInXyz[3].x);
+  const __m256 y = _mm256_setr_ps(abcdInXyz[0].y, abcdInXyz[1].y, abcdInXyz[2].y, abcdInXyz[3].y, abcdInXyz[0].y, abcdInXyz[1].y, abcdInXyz[2].y, abcdInXyz[3].y);
+  const __m256 z = _mm256_setr_ps(abcdInXyz[0].z, abcdInXyz[1].z, abcdInXyz[2].z, abcdInXyz[3].z, abcdInXyz[0].z, abcdInXyz[1].z, abcdInXyz[2].z, abcdInXyz[3].z);
+  const __m256 zero = _mm256_setzero_ps();
+  int o = 0;
+  for(; o + 2 <= objects; o += 2)
+  {
+    const __m256 dx = _mm256_setr_m128(_mm_set1_ps(to[o].x - from[o].x), _mm_set1_ps(to[o + 1].x - from[o + 1].x));
+    const __m256 dy = _mm256_setr_m128(_mm_set1_ps(to[o].y - from[o].y), _mm_set1_ps(to[o + 1].y - from[o + 1].y));
+    const __m256 dz = _mm256_setr_m128(_mm_set1_ps(to[o].z - from[o].z), _mm_set1_ps(to[o + 1].z - from[o + 1].z));
+    const __m256 delta = _mm256_fmadd_ps(dz, z, _mm256_fmadd_ps(dy, y, _mm256_mul_ps(dx, x)));
+    _mm256_storeu_ps((float*)&sweptMin[o], _mm256_add_ps(_mm256_loadu_ps((const float*)&startMin[o]), _mm256_min_ps(delta, zero)));
+    _mm256_storeu_ps((float*)&sweptMax[o], _mm256_add_ps(_mm256_loadu_ps((const float*)&startMax[o]), _mm256_max_ps(delta, zero)));
+  }
+  for(; o < objects; ++o)
+    SweepScalar(startMin[o], startMax[o], from[o], to[o], &sweptMin[o], &sweptMax[o]);
+}
+
+// The tetrahedron-first query of aabo.cpp, run on swept AABOs, writing out what it finds.
+int Candidates(const AABT* aabtMin, const AABT* aabtMax, int objects, const AABT probeMin, const AABT probeMax, int* candidate)
+{
+  int candidates = 0;
+  for(int t = 0; t < objects; ++t)
+  {
+    const AABT targetMin = aabtMin[t];
+    if(targetMin <= probeMax)
+    {
+      const AABT targetMax = aabtMax[t];
+      if(probeMin <= targetMax)
+        candidate[candidates++] = t;
+    }
+  }
+  return candidates;
+}
+
+// When during the frame two moving AABOs overlap. At time s in [0, 1], each of the eight
+// plane tests between them is linear in s, so each allows a half-line of times, and the
+// AABOs overlap in the intersection of those. Returns false if that misses the frame.
+bool TimeOfImpact(const AABT& probeMin, const AABT& probeMax, const float4 probeDelta,
+                  const AABT& targetMin, const AABT& targetMax, const float4 targetDelta, float* enter, float* exit)
+{
+  const float pMin[4] = {probeMin.a, probeMin.b, probeMin.c, probeMin.d};
+  const float pMax[4] = {probeMax.a, probeMax.b, probeMax.c, probeMax.d};
+  const float tMin[4] = {targetMin.a, targetMin.b, targetMin.c, targetMin.d};
+  const float tMax[4] = {targetMax.a, targetMax.b, targetMax.c, targetMax.d};
+  const float pDelta[4] = {probeDelta.a, probeDelta.b, probeDelta.c, probeDelta.d};
+  const float tDelta[4] = {targetDelta.a, targetDelta.b, targetDelta.c, targetDelta.d};
+  float lo = 0.f, hi = 1.f;
+  for(int axis = 0; axis < 4; ++axis)
+  {
+    // the probe, seen from the target, moves by v: it must keep pMin+vs <= tMax and tMin <= pMax+vs
+    const float v = pDelta[axis] - tDelta[axis];
+    const float upGap = tMax[axis] - pMin[axis];   // v*s <= upGap
+    const float downGap = tMin[axis] - pMax[axis]; // v*s >= downGap
+    if(v == 0.f)
+    {
+      if(upGap < 0.f || downGap > 0.f)
+        return false;
+    }
+    else if(v > 0.f)
+    {
+      hi = std::min(hi, upGap / v);
+      lo = std::max(lo, downGap / v);
+    }
+    else
+    {
+      hi = std::min(hi, downGap / v);
+      lo = std::max(lo, upGap / v);
+    }
+  }
+  *enter = lo;
+  *exit = hi;
+  return lo <= hi;
+}
+
+void Move(const AABT& mini, const AABT& maxi, const float4 delta, float s, AABT* movedMin, AABT* movedMax)
+{
+  movedMin->abcd = _mm_add_ps(mini.abcd, _mm_mul_ps(delta.abcd, _mm_set1_ps(s)));
+  movedMax->abcd = _mm_add_ps(maxi.abcd, _mm_mul_ps(delta.abcd, _mm_set1_ps(s)));
+}
+
+int main(int argc, char* argv[])
+{
+  Mesh mesh;
+  mesh.Generate(100, 1.0f);
+
+  const int kTests = 100;
+  const float kSpeed = 3.f; // per frame, enough to carry an object past another of its size
+
+  const int kObjects = 10000000;
+  std::vector<Object> objects(kObjects);
+  std::vector<float3> from(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    objects[o].m_mesh = &mesh;
+    objects[o].m_position.x = random(-50.f, 50.f);
+    objects[o].m_position.y = random(-50.f, 50.f);
+    objects[o].m_position.z = random(-50.f, 50.f);
+    from[o] = objects[o].m_position;
+  }
+
+  std::vector<AABT> startMin(kObjects);
+  std::vector<AABT> startMax(kObjects);
+  for(int a = 0; a < kObjects; ++a)
+    objects[a].CalculateAABT(&startMin[a], &startMax[a]);
+
+  // the frame: everything moves
+  std::vector<float3> to(kObjects);
+  std::vector<AABT> endMin(kObjects);
+  std::vector<AABT> endMax(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    objects[o].m_position.x += random(-kSpeed, kSpeed);
+    objects[o].m_position.y += random(-kSpeed, kSpeed);
+    objects[o].m_position.z += random(-kSpeed, kSpeed);
+    to[o] = objects[o].m_position;
+    const float4 delta = xyzToAbcd(to[o] - from[o]);
+    endMin[o].abcd = _mm_add_ps(startMin[o].abcd, delta.abcd);
+    endMax[o].abcd = _mm_add_ps(startMax[o].abcd, delta.abcd);
+  }
+
+  std::vector<AABT> sweptMin(kObjects);
+  std::vector<AABT> sweptMax(kObjects);
+  {
+    const Clock clock;
+    for(int o = 0; o < kObjects; ++o)
+      SweepScalar(startMin[o], startMax[o], from[o], to[o], &sweptMin[o], &sweptMax[o]);
+    const float seconds = clock.seconds();
+    printf("Swept AABOs, scalar, built in %f seconds\n", seconds);
+  }
+  {
+    const Clock clock;
+    Sweep(startMin.data(), startMax.data(), from.data(), to.data(), kObjects, sweptMin.data(), sweptMax.data());
+    const float seconds = clock.seconds();
+    printf("Swept AABOs, SIMD, built in %f seconds\n", seconds);
+  }
+
+  {
+    const Clock clock;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+    {
+      const AABT probeMin = endMin[test];
+      const AABT probeMax = endMax[test];
+      for(int t = 0; t < kObjects; ++t)
+      {
+        const AABT targetMin = endMin[t];
+        if(targetMin <= probeMax)
+        {
+          const AABT targetMax = endMax[t];
+          if(probeMin <= targetMax)
+            ++intersections;
+        }
+      }
+    }
+    const float seconds = clock.seconds();
+    printf("AABO at the end of the frame reported %d intersections in %f seconds\n", intersections, seconds);
+  }
+
+  std::vector<int> candidate(kObjects);
+  int candidates = 0, impacts = 0, tunnelled = 0, wrong = 0;
+  float queryClock = 0.f, impactClock = 0.f;
+  for(int test = 0; test < kTests; ++test)
+  {
+    const Clock query;
+    const int n = Candidates(sweptMin.data(), sweptMax.data(), kObjects, sweptMin[test], sweptMax[test], candidate.data());
+    queryClock += query.seconds();
+    candidates += n;
+
+    const Clock impact;
+    const float4 probeDelta = xyzToAbcd(to[test] - from[test]);
+    std::vector<int> hit(n);
+    std::vector<float> enterAt(n);
+    for(int c = 0; c < n; ++c)
+    {
+      const int t = candidate[c];
+      float enter, exit;
+      hit[c] = TimeOfImpact(startMin[test], startMax[test], probeDelta, startMin[t], startMax[t], xyzToAbcd(to[t] - from[t]), &enter, &exit);
+      enterAt[c] = enter;
+    }
+    impactClock += impact.seconds();
+
+    // an impact should really be an overlap, at the time it is said to start, and one that
+    // the end of the frame alone would miss is a tunnelling
+    for(int c = 0; c < n; ++c)
+    {
+      if(!hit[c])
+        continue;
+      ++impacts;
+      const int t = candidate[c];
+      AABT pMin, pMax, tMin, tMax;
+      Move(startMin[test], startMax[test], probeDelta, enterAt[c], &pMin, &pMax);
+      Move(startMin[t], startMax[t], xyzToAbcd(to[t] - from[t]), enterAt[c], &tMin, &tMax);
+      const float4 slack = {1e-4f, 1e-4f, 1e-4f, 1e-4f};
+      pMin.abcd = _mm_sub_ps(pMin.abcd, slack.abcd);
+      pMax.abcd = _mm_add_ps(pMax.abcd, slack.abcd);
+      wrong += !(pMin <= tMax && tMin <= pMax);
+      tunnelled += !(endMin[test] <= endMax[t] && endMin[t] <= endMax[test]);
+    }
+  }
+  printf("Swept AABO reported %d candidates in %f seconds\n", candidates, queryClock);
+  printf("Time of impact found %d overlaps among them in %f seconds, %d of them missed at the end of the frame, %d not overlapping when said to start\n",
+         impacts, impactClock, tunnelled, wrong);
+  return 0;
+}
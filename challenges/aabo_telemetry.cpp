@@ -0,0 +1,342 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include <immintrin.h>
+
+struct Clock
+{
+  const clock_t m_start;
+  Clock() : m_start(clock())
+  {
+  }
+  float seconds() const
+  {
+    const clock_t end = clock();
+    const float seconds = ((float)(end - m_start)) / CLOCKS_PER_SEC;
+    return seconds;
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+// Telemetry is compiled in unless this is defined to 0. Kernels also take it as a template
+// argument, so one binary can run both ways to measure what it costs.
+#ifndef AABO_TELEMETRY
+#define AABO_TELEMETRY 1
+#endif
+
+// What one query did. Only the partial accepts are counted inside the loop, and only on the
+// branch that is already rare; everything else follows from them after the loop.
+struct QueryStats
+{
+  uint64_t m_tested;       // objects whose up tetrahedron was read
+  uint64_t m_upRejected;   // rejected by the up tetrahedron alone
+  uint64_t m_downRejected; // passed the up tetrahedron, then rejected by the down one
+  uint64_t m_accepted;
+  uint64_t m_bytesFetched; // up column scanned, plus every cache line of the down column touched
+
+  QueryStats& operator+=(const QueryStats& s)
+  {
+    m_tested += s.m_tested;
+    m_upRejected += s.m_upRejected;
+    m_downRejected += s.m_downRejected;
+    m_accepted += s.m_accepted;
+    m_bytesFetched += s.m_bytesFetched;
+    return *this;
+  }
+};
+
+// Counts of values by power of two: bucket 0 holds zeros, and bucket b holds [2^(b-1), 2^b).
+struct Log2Histogram
+{
+  static const int kBuckets = 65;
+  uint64_t m_count[kBuckets];
+
+  Log2Histogram()
+  {
+    std::fill(m_count, m_count + kBuckets, 0);
+  }
+
+  static int Bucket(uint64_t value)
+  {
+    return value ? 64 - __builtin_clzll(value) : 0;
+  }
+
+  void Add(uint64_t value)
+  {
+    ++m_count[Bucket(value)];
+  }
+
+  int Lowest() const
+  {
+    int b = 0;
+    while(b < kBuckets - 1 && m_count[b] == 0)
+      ++b;
+    return b;
+  }
+
+  int Highest() const
+  {
+    int b = kBuckets - 1;
+    while(b > 0 && m_count[b] == 0)
+      --b;
+    return b;
+  }
+};
+
+// Everything a query engine has seen since it started: the running totals, and how the
+// per-query numbers are distributed, which is where a drift in selectivity shows up first.
+struct Telemetry
+{
+  QueryStats m_total;
+  uint64_t m_queries;
+  Log2Histogram m_upPassed;
+  Log2Histogram m_downRejected;
+  Log2Histogram m_accepted;
+  Log2Histogram m_bytesFetched;
+
+  Telemetry() : m_queries(0)
+  {
+    m_total.m_tested = m_total.m_upRejected = m_total.m_downRejected = m_total.m_accepted = m_total.m_bytesFetched = 0;
+  }
+
+  void Record(const QueryStats& s)
+  {
+    m_total += s;
+    ++m_queries;
+    m_upPassed.Add(s.m_tested - s.m_upRejected);
+    m_downRejected.Add(s.m_downRejected);
+    m_accepted.Add(s.m_accepted);
+    m_bytesFetched.Add(s.m_bytesFetched);
+  }
+
+  void Print() const
+  {
+    printf("%llu queries, %llu objects tested: %llu up rejects, %llu down rejects, %llu accepts, %.1f MB fetched\n",
+           (unsigned long long)m_queries, (unsigned long long)m_total.m_tested, (unsigned long long)m_total.m_upRejected,
+           (unsigned long long)m_total.m_downRejected, (unsigned long long)m_total.m_accepted, m_total.m_bytesFetched / (1024.f * 1024.f));
+    printf("\n");
+    const char *title = "%21s | %9s | %9s | %9s | %9s\n";
+    printf(title, "per query", "up", "down", "accepts", "bytes");
+    printf(title, "", "passes", "rejects", "", "fetched");
+    printf("-----------------------------------------------------------------------\n");
+    const int highest = std::max(std::max(m_upPassed.Highest(), m_downRejected.Highest()),
+                                 std::max(m_accepted.Highest(), m_bytesFetched.Highest()));
+    const int lowest = std::min(std::min(m_upPassed.Lowest(), m_downRejected.Lowest()),
+                                std::min(m_accepted.Lowest(), m_bytesFetched.Lowest()));
+    for(int b = lowest; b <= highest; ++b)
+    {
+      char range[48];
+      if(b == 0)
+        snprintf(range, sizeof(range), "0");
+      else
+        snprintf(range, sizeof(range), "%llu - %llu", 1ull << (b - 1), (1ull << b) - 1);
+      printf("%21s | %9llu | %9llu | %9llu | %9llu\n", range,
+             (unsigned long long)m_upPassed.m_count[b], (unsigned long long)m_downRejected.m_count[b],
+             (unsigned long long)m_accepted.m_count[b], (unsigned long long)m_bytesFetched.m_count[b]);
+    }
+  }
+};
+
+// The AABO query of aabo.cpp. With telemetry off, stats is never touched and the
+// counting compiles away.
+template<bool kTelemetry> int Intersections(const AABT* aabtMin, const AABT* aabtMax, int objects, const AABT probeMin, const AABT probeMax, QueryStats* stats)
+{
+  int partials = 0;
+  int intersections = 0;
+  intptr_t lastLine = -1;
+  int downLines = 0;
+  for(int t = 0; t < objects; ++t)
+  {
+    const AABT targetMin = aabtMin[t];
+    if(targetMin <= probeMax)
+    {
+      if(kTelemetry)
+      {
+        ++partials;
+        const intptr_t line = (intptr_t)&aabtMax[t] / 64;
+        downLines += line != lastLine;
+        lastLine = line;
+      }
+      const AABT targetMax = aabtMax[t];
+      if(probeMin <= targetMax)
+        ++intersections;
+    }
+  }
+  if(kTelemetry)
+  {
+    stats->m_tested = objects;
+    stats->m_upRejected = objects - partials;
+    stats->m_downRejected = partials - intersections;
+    stats->m_accepted = intersections;
+    stats->m_bytesFetched = (uint64_t)objects * sizeof(AABT) + (uint64_t)downLines * 64;
+  }
+  return intersections;
+}
+
+int main(int argc, char* argv[])
+{
+  // meshes of many sizes, so that the queries vary a lot in how selective they are
+  const int kMeshes = 100;
+  Mesh mesh[kMeshes];
+  for(int m = 0; m < kMeshes; ++m)
+    mesh[m].Generate(50, powf(2.f, random(-1.f, 3.f)));
+
+  const int kTests = 100;
+
+  const int kObjects = 10000000;
+  std::vector<Object> objects(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    objects[o].m_mesh = &mesh[rand() % kMeshes];
+    objects[o].m_position.x = random(-50.f, 50.f);
+    objects[o].m_position.y = random(-50.f, 50.f);
+    objects[o].m_position.z = random(-50.f, 50.f);
+  }
+
+  std::vector<AABT> aabtMin(kObjects);
+  std::vector<AABT> aabtMax(kObjects);
+  for(int a = 0; a < kObjects; ++a)
+    objects[a].CalculateAABT(&aabtMin[a], &aabtMax[a]);
+
+  {
+    const Clock clock;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+      intersections += Intersections<false>(aabtMin.data(), aabtMax.data(), kObjects, aabtMin[test], aabtMax[test], 0);
+    const float seconds = clock.seconds();
+
+    printf("AABO, telemetry off, reported %d intersections in %f seconds\n", intersections, seconds);
+  }
+
+  Telemetry telemetry;
+  {
+    const Clock clock;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+    {
+      QueryStats stats;
+      intersections += Intersections<AABO_TELEMETRY>(aabtMin.data(), aabtMax.data(), kObjects, aabtMin[test], aabtMax[test], &stats);
+      if(AABO_TELEMETRY)
+        telemetry.Record(stats);
+    }
+    const float seconds = clock.seconds();
+
+    printf("AABO, telemetry %s, reported %d intersections in %f seconds\n", AABO_TELEMETRY ? "on" : "compiled out", intersections, seconds);
+  }
+
+  if(AABO_TELEMETRY)
+  {
+    printf("\n");
+    telemetry.Print();
+  }
+  return 0;
+}
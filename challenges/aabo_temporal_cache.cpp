@@ -0,0 +1,346 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+#include <immintrin.h>
+
+struct Clock
+{
+  const clock_t m_start;
+  Clock() : m_start(clock())
+  {
+  }
+  float seconds() const
+  {
+    const clock_t end = clock();
+    const float seconds = ((float)(end - m_start)) / CLOCKS_PER_SEC;
+    return seconds;
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+// Objects that move only now and then, each one's bounds its mesh's bounds moved by its
+// position. Every refit leaves behind the sorted list of the objects it changed.
+struct Scene
+{
+  AABT m_meshMin;
+  AABT m_meshMax;
+  std::vector<float3> m_position;
+  std::vector<AABT> m_aabtMin;
+  std::vector<AABT> m_aabtMax;
+  std::vector<int> m_dirty;
+
+  void Fit(int o)
+  {
+    const float4 offset = xyzToAbcd(m_position[o]);
+    m_aabtMin[o].abcd = _mm_add_ps(m_meshMin.abcd, offset.abcd);
+    m_aabtMax[o].abcd = _mm_add_ps(m_meshMax.abcd, offset.abcd);
+  }
+
+  // Nudges the probes, which move every frame, and some other objects picked at random.
+  void Refit(int probes, int movers, float step)
+  {
+    m_dirty.clear();
+    for(int o = 0; o < probes; ++o)
+      m_dirty.push_back(o);
+    for(int m = 0; m < movers; ++m)
+      m_dirty.push_back((int)(((uint64_t)rand() * RAND_MAX + rand()) % m_position.size()));
+    std::sort(m_dirty.begin(), m_dirty.end());
+    m_dirty.erase(std::unique(m_dirty.begin(), m_dirty.end()), m_dirty.end());
+    for(int d = 0; d < m_dirty.size(); ++d)
+    {
+      const int o = m_dirty[d];
+      m_position[o].x += random(-step, step);
+      m_position[o].y += random(-step, step);
+      m_position[o].z += random(-step, step);
+      Fit(o);
+    }
+  }
+};
+
+int Intersections(const Scene& scene, const AABT probeMin, const AABT probeMax)
+{
+  int intersections = 0;
+  for(int t = 0; t < scene.m_aabtMin.size(); ++t)
+  {
+    const AABT targetMin = scene.m_aabtMin[t];
+    if(targetMin <= probeMax)
+    {
+      const AABT targetMax = scene.m_aabtMax[t];
+      if(probeMin <= targetMax)
+        ++intersections;
+    }
+  }
+  return intersections;
+}
+
+struct CacheStats
+{
+  uint64_t m_hits;
+  uint64_t m_misses;
+  uint64_t m_tested;  // objects whose bounds were read
+  uint64_t m_skipped; // objects a full scan would have read, but the cache didn't
+};
+
+// What a probe found last frame: every object that overlapped an AABO grown around the probe
+// by a margin along all four axes. As long as the probe stays inside that grown AABO, any
+// object that overlaps the probe is on the list or has moved since, so a query reads the
+// list, takes out the objects on the refit's dirty list, and tests those against the grown
+// AABO again. The list only follows the dirty lists of consecutive frames, so a probe that
+// skips a frame, or leaves its grown AABO, scans everything again.
+class TemporalCache
+{
+public:
+  TemporalCache(int probes, float margin) : m_entry(probes), m_margin(_mm_set1_ps(margin))
+  {
+    for(int p = 0; p < probes; ++p)
+      m_entry[p].m_frame = -2;
+    m_stats.m_hits = m_stats.m_misses = m_stats.m_tested = m_stats.m_skipped = 0;
+  }
+
+  int Intersections(const Scene& scene, int probe, const AABT probeMin, const AABT probeMax, int frame)
+  {
+    Entry& entry = m_entry[probe];
+    const int objects = scene.m_aabtMin.size();
+    if(entry.m_frame == frame - 1 && entry.m_min <= probeMin && probeMax <= entry.m_max)
+    {
+      ++m_stats.m_hits;
+      m_kept.clear();
+      std::set_difference(entry.m_candidate.begin(), entry.m_candidate.end(), scene.m_dirty.begin(), scene.m_dirty.end(), std::back_inserter(m_kept));
+      m_moved.clear();
+      for(int d = 0; d < scene.m_dirty.size(); ++d)
+      {
+        const int o = scene.m_dirty[d];
+        if(scene.m_aabtMin[o] <= entry.m_max && entry.m_min <= scene.m_aabtMax[o])
+          m_moved.push_back(o);
+      }
+      entry.m_candidate.clear();
+      std::merge(m_kept.begin(), m_kept.end(), m_moved.begin(), m_moved.end(), std::back_inserter(entry.m_candidate));
+      m_stats.m_tested += scene.m_dirty.size();
+      m_stats.m_skipped += objects - scene.m_dirty.size() - entry.m_candidate.size();
+    }
+    else
+    {
+      ++m_stats.m_misses;
+      entry.m_min.abcd = _mm_sub_ps(probeMin.abcd, m_margin);
+      entry.m_max.abcd = _mm_add_ps(probeMax.abcd, m_margin);
+      entry.m_candidate.clear();
+      for(int t = 0; t < objects; ++t)
+      {
+        const AABT targetMin = scene.m_aabtMin[t];
+        if(targetMin <= entry.m_max)
+        {
+          const AABT targetMax = scene.m_aabtMax[t];
+          if(entry.m_min <= targetMax)
+            entry.m_candidate.push_back(t);
+        }
+      }
+      m_stats.m_tested += objects;
+    }
+    entry.m_frame = frame;
+
+    int intersections = 0;
+    for(int c = 0; c < entry.m_candidate.size(); ++c)
+    {
+      const int t = entry.m_candidate[c];
+      intersections += scene.m_aabtMin[t] <= probeMax && probeMin <= scene.m_aabtMax[t];
+    }
+    m_stats.m_tested += entry.m_candidate.size();
+    return intersections;
+  }
+
+  const CacheStats& Stats() const
+  {
+    return m_stats;
+  }
+
+private:
+  struct Entry
+  {
+    AABT m_min; // the grown AABO
+    AABT m_max;
+    std::vector<int> m_candidate; // sorted
+    int m_frame;
+  };
+
+  std::vector<Entry> m_entry;
+  const __m128 m_margin;
+  std::vector<int> m_kept;  // scratch, kept to save allocating every query
+  std::vector<int> m_moved;
+  CacheStats m_stats;
+};
+
+int main(int argc, char* argv[])
+{
+  Mesh mesh;
+  mesh.Generate(100, 1.0f);
+  Object origin;
+  origin.m_mesh = &mesh;
+  origin.m_position.x = origin.m_position.y = origin.m_position.z = 0.f;
+
+  const int kObjects = 1000000;
+  const int kProbes = 32;
+  const int kMovers = 10000; // objects other than the probes that move in a frame
+  const int kFrames = 50;
+  const float kStep = 0.05f;
+  const float kMargin = 0.5f;
+
+  Scene scene;
+  origin.CalculateAABT(&scene.m_meshMin, &scene.m_meshMax);
+  scene.m_position.resize(kObjects);
+  scene.m_aabtMin.resize(kObjects);
+  scene.m_aabtMax.resize(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    scene.m_position[o].x = random(-50.f, 50.f);
+    scene.m_position[o].y = random(-50.f, 50.f);
+    scene.m_position[o].z = random(-50.f, 50.f);
+    scene.Fit(o);
+  }
+
+  TemporalCache cache(kProbes, kMargin);
+  float scanSeconds = 0.f, cacheSeconds = 0.f;
+  int scanIntersections = 0, cacheIntersections = 0, mismatches = 0;
+  for(int frame = 0; frame < kFrames; ++frame)
+  {
+    scene.Refit(kProbes, kMovers, kStep);
+    std::vector<int> expected(kProbes);
+    {
+      const Clock clock;
+      for(int test = 0; test < kProbes; ++test)
+        expected[test] = Intersections(scene, scene.m_aabtMin[test], scene.m_aabtMax[test]);
+      scanSeconds += clock.seconds();
+    }
+    {
+      const Clock clock;
+      for(int test = 0; test < kProbes; ++test)
+      {
+        const int intersections = cache.Intersections(scene, test, scene.m_aabtMin[test], scene.m_aabtMax[test], frame);
+        cacheIntersections += intersections;
+        mismatches += intersections != expected[test];
+      }
+      cacheSeconds += clock.seconds();
+    }
+    for(int test = 0; test < kProbes; ++test)
+      scanIntersections += expected[test];
+  }
+
+  const CacheStats& stats = cache.Stats();
+  printf("AABO scan every frame reported %d intersections in %f seconds\n", scanIntersections, scanSeconds);
+  printf("AABO temporal cache reported %d intersections in %f seconds, %d queries disagreeing with the scan\n", cacheIntersections, cacheSeconds, mismatches);
+  printf("  %llu hits, %llu misses, %.1f%% hit rate\n", (unsigned long long)stats.m_hits, (unsigned long long)stats.m_misses,
+         100.0 * stats.m_hits / (stats.m_hits + stats.m_misses));
+  printf("  %llu objects tested, %llu skipped, %.1f%% of the bounds a scan reads\n", (unsigned long long)stats.m_tested, (unsigned long long)stats.m_skipped,
+         100.0 * stats.m_tested / ((uint64_t)kObjects * kProbes * kFrames));
+  return 0;
+}
@@ -0,0 +1,572 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include <immintrin.h>
+
+struct Clock
+{
+  const clock_t m_start;
+  Clock() : m_start(clock())
+  {
+  }
+  float seconds() const
+  {
+    const clock_t end = clock();
+    const float seconds = ((float)(end - m_start)) / CLOCKS_PER_SEC;
+    return seconds;
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+float3 min(const float3 a, const float3 b)
+{
+  float3 c = {std::min(a.x,b.x), std::min(a.y,b.y), std::min(a.z,b.z)};
+  return c;
+}
+
+float3 max(const float3 a, const float3 b)
+{
+  float3 c = {std::max(a.x,b.x), std::max(a.y,b.y), std::max(a.z,b.z)};
+  return c;
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABB(float3* mini, float3* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyz;
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      *mini = min(*mini, xyz);
+      *maxi = max(*maxi, xyz);
+    }
+  }
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+float3 operator-(const float3 a, const float3 b)
+{
+  float3 c = {a.x-b.x, a.y-b.y, a.z-b.z};
+  return c;
+}
+
+float3 operator-(const float3 a)
+{
+  float3 c = {-a.x, -a.y, -a.z};
+  return c;
+}
+
+float3 operator*(const float3 a, const float b)
+{
+  float3 c = {a.x*b, a.y*b, a.z*b};
+  return c;
+}
+
+float3 cross(const float3 a, const float3 b)
+{
+  float3 c = {a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x};
+  return c;
+}
+
+typedef float4 BoundingSphere;
+
+void CalculateBoundingSphere(const Object& object, BoundingSphere* sphere)
+{
+  float3 mini, maxi;
+  object.CalculateAABB(&mini, &maxi);
+  const float3 center = (mini + maxi) * 0.5f;
+  float maxRadius = 0.f;
+  for(int p = 0; p < object.m_mesh->m_point.size(); ++p)
+    maxRadius = std::max(maxRadius, length(object.m_position + object.m_mesh->m_point[p] - center));
+  sphere->a = center.x;
+  sphere->b = center.y;
+  sphere->c = center.z;
+  sphere->d = maxRadius;
+}
+
+// The convex hull of a set of points, which is all GJK needs to know about it.
+struct PointSet
+{
+  const float3* m_point;
+  int m_points;
+  float3 m_offset;
+
+  PointSet(const Object& object) : m_point(object.m_mesh->m_point.data()), m_points(object.m_mesh->m_point.size()), m_offset(object.m_position)
+  {
+  }
+  PointSet(const float3* point, int points, const float3 offset) : m_point(point), m_points(points), m_offset(offset)
+  {
+  }
+
+  float3 Support(const float3 direction) const
+  {
+    int best = 0;
+    float bestDot = dot(m_point[0], direction);
+    for(int p = 1; p < m_points; ++p)
+    {
+      const float d = dot(m_point[p], direction);
+      if(d > bestDot)
+      {
+        bestDot = d;
+        best = p;
+      }
+    }
+    return m_point[best] + m_offset;
+  }
+};
+
+// GJK, as a yes/no test: do the convex hulls of two point sets overlap? It searches the
+// Minkowski difference A-B for a simplex that contains the origin, keeping only the feature
+// of the simplex nearest the origin at each step. The newest point is always last.
+struct Simplex
+{
+  float3 m_point[4];
+  int m_points;
+};
+
+bool Line(Simplex* s, float3* direction)
+{
+  const float3 a = s->m_point[1];
+  const float3 ab = s->m_point[0] - a;
+  const float3 ao = -a;
+  if(dot(ab, ao) > 0.f)
+    *direction = cross(cross(ab, ao), ab);
+  else
+  {
+    s->m_point[0] = a;
+    s->m_points = 1;
+    *direction = ao;
+  }
+  return false;
+}
+
+bool Triangle(Simplex* s, float3* direction)
+{
+  const float3 c = s->m_point[0], b = s->m_point[1], a = s->m_point[2];
+  const float3 ab = b - a, ac = c - a, ao = -a;
+  const float3 abc = cross(ab, ac);
+  if(dot(cross(abc, ac), ao) > 0.f)
+  {
+    if(dot(ac, ao) > 0.f)
+    {
+      s->m_point[1] = a;
+      s->m_points = 2;
+      *direction = cross(cross(ac, ao), ac);
+      return false;
+    }
+    s->m_point[0] = b;
+    s->m_point[1] = a;
+    s->m_points = 2;
+    return Line(s, direction);
+  }
+  if(dot(cross(ab, abc), ao) > 0.f)
+  {
+    s->m_point[0] = b;
+    s->m_point[1] = a;
+    s->m_points = 2;
+    return Line(s, direction);
+  }
+  if(dot(abc, ao) > 0.f)
+    *direction = abc;
+  else
+  {
+    s->m_point[0] = b;
+    s->m_point[1] = c;
+    *direction = -abc;
+  }
+  return false;
+}
+
+// The normal of face abc, flipped if need be to point away from the simplex's fourth point.
+float3 Outward(const float3 a, const float3 b, const float3 c, const float3 away)
+{
+  const float3 n = cross(b - a, c - a);
+  return dot(n, away - a) > 0.f ? -n : n;
+}
+
+bool Tetrahedron(Simplex* s, float3* direction)
+{
+  const float3 d = s->m_point[0], c = s->m_point[1], b = s->m_point[2], a = s->m_point[3];
+  const float3 ao = -a;
+  const float3 face[3][3] = {{c, b, a}, {d, c, a}, {b, d, a}};
+  const float3 opposite[3] = {d, b, c};
+  for(int f = 0; f < 3; ++f)
+    if(dot(Outward(a, face[f][0], face[f][1], opposite[f]), ao) > 0.f)
+    {
+      s->m_point[0] = face[f][0];
+      s->m_point[1] = face[f][1];
+      s->m_point[2] = a;
+      s->m_points = 3;
+      return Triangle(s, direction);
+    }
+  return true;
+}
+
+// Touching and numerically degenerate cases run out of iterations and answer yes, which
+// errs the same way a bounding volume does.
+bool Overlap(const PointSet& a, const PointSet& b)
+{
+  const float3 x = {1.f, 0.f, 0.f};
+  Simplex s;
+  s.m_point[0] = a.Support(x) - b.Support(-x);
+  s.m_points = 1;
+  float3 direction = -s.m_point[0];
+  for(int iteration = 0; iteration < 64; ++iteration)
+  {
+    if(dot(direction, direction) < 1e-12f)
+      return true;
+    const float3 p = a.Support(direction) - b.Support(-direction);
+    if(dot(p, direction) < 0.f)
+      return false;
+    s.m_point[s.m_points++] = p;
+    const bool contains = s.m_points == 2 ? Line(&s, &direction)
+                        : s.m_points == 3 ? Triangle(&s, &direction)
+                        : Tetrahedron(&s, &direction);
+    if(contains)
+      return true;
+  }
+  return true;
+}
+
+bool Inside(const PointSet& hull, const float3 point)
+{
+  const float3 zero = {0.f, 0.f, 0.f};
+  return Overlap(hull, PointSet(&point, 1, zero));
+}
+
+// Where the three planes of the up tetrahedron other than plane j meet.
+float3 TetrahedronVertex(const AABT mini, int j)
+{
+  const float m[4] = {mini.a, mini.b, mini.c, mini.d};
+  int i[3], n = 0;
+  for(int k = 0; k < 4; ++k)
+    if(k != j)
+      i[n++] = k;
+  const float3 n0 = abcdInXyz[i[0]], n1 = abcdInXyz[i[1]], n2 = abcdInXyz[i[2]];
+  const float3 sum = cross(n1, n2) * m[i[0]] + cross(n2, n0) * m[i[1]] + cross(n0, n1) * m[i[2]];
+  return sum * (1.f / dot(n0, cross(n1, n2)));
+}
+
+enum Volume
+{
+  kAABB,
+  kSevenSided,
+  kAABO,
+  kTetrahedron,
+  kSphere,
+  kVolumes
+};
+
+const char* const kVolumeName[] = { "AABB", "7-Sided AABB", "AABO", "Tetrahedron", "Sphere" };
+
+// Every bounding volume of one object, for testing points against.
+struct Bounds
+{
+  float3 m_aabbMin, m_aabbMax;
+  float m_sumMin, m_sumMax; // the 7-sided AABB's diagonal, from the AABB's corners
+  AABT m_aabtMin, m_aabtMax;
+  BoundingSphere m_sphere;
+
+  Bounds(const Object& object)
+  {
+    object.CalculateAABB(&m_aabbMin, &m_aabbMax);
+    m_sumMin = m_aabbMin.x + m_aabbMin.y + m_aabbMin.z;
+    m_sumMax = m_aabbMax.x + m_aabbMax.y + m_aabbMax.z;
+    object.CalculateAABT(&m_aabtMin, &m_aabtMax);
+    CalculateBoundingSphere(object, &m_sphere);
+  }
+
+  bool Contains(Volume volume, const float3 p) const
+  {
+    const bool inAABB = m_aabbMin.x <= p.x && p.x <= m_aabbMax.x
+                     && m_aabbMin.y <= p.y && p.y <= m_aabbMax.y
+                     && m_aabbMin.z <= p.z && p.z <= m_aabbMax.z;
+    const float4 abcd = xyzToAbcd(p);
+    const float3 center = {m_sphere.a, m_sphere.b, m_sphere.c};
+    switch(volume)
+    {
+    case kAABB:
+      return inAABB;
+    case kSevenSided:
+      return inAABB && m_sumMin <= p.x + p.y + p.z && p.x + p.y + p.z <= m_sumMax;
+    case kAABO:
+      return m_aabtMin <= abcd && abcd <= m_aabtMax;
+    case kTetrahedron:
+      return m_aabtMin <= abcd;
+    default:
+      return length(p - center) <= m_sphere.d;
+    }
+  }
+};
+
+struct Pair
+{
+  int m_probe;
+  int m_target;
+};
+
+// Times one straight counting loop over every test and object, so the broad phase of each
+// volume is measured without a branch on the volume type or a push_back in it. The pairs
+// for the narrow phase are gathered afterwards, off the clock.
+template<typename Accept> float BroadPhase(int tests, int objects, Accept accept, int* accepts, std::vector<Pair>* pairs)
+{
+  const Clock clock;
+  int count = 0;
+  for(int test = 0; test < tests; ++test)
+    for(int t = 0; t < objects; ++t)
+      count += accept(test, t);
+  const float seconds = clock.seconds();
+
+  *accepts = count;
+  for(int test = 0; test < tests; ++test)
+    for(int t = 0; t < objects; ++t)
+      if(accept(test, t))
+      {
+        const Pair pair = {test, t};
+        pairs->push_back(pair);
+      }
+  return seconds;
+}
+
+int main(int argc, char* argv[])
+{
+  const int kMeshes = 100;
+  Mesh mesh[kMeshes];
+  for(int m = 0; m < kMeshes; ++m)
+    mesh[m].Generate(50, 1.f);
+
+  const int kTests = 100;
+  const int kSamples = 20000; // Monte Carlo samples per mesh
+
+  // Volume ratios, per mesh at the origin. Samples are drawn from a box around the
+  // tetrahedron and the sphere, which between them contain every other volume.
+  double inVolume[kVolumes] = {0};
+  double inHull = 0;
+  int escapes = 0;
+  for(int m = 0; m < kMeshes; ++m)
+  {
+    Object object;
+    object.m_mesh = &mesh[m];
+    object.m_position.x = object.m_position.y = object.m_position.z = 0.f;
+    const Bounds bounds(object);
+    const PointSet hull(object);
+    const float3 r = {bounds.m_sphere.d, bounds.m_sphere.d, bounds.m_sphere.d};
+    const float3 center = {bounds.m_sphere.a, bounds.m_sphere.b, bounds.m_sphere.c};
+    float3 lo = center - r, hi = center + r;
+    for(int j = 0; j < 4; ++j)
+    {
+      lo = min(lo, TetrahedronVertex(bounds.m_aabtMin, j));
+      hi = max(hi, TetrahedronVertex(bounds.m_aabtMin, j));
+    }
+    for(int s = 0; s < kSamples; ++s)
+    {
+      const float3 p = {random(lo.x, hi.x), random(lo.y, hi.y), random(lo.z, hi.z)};
+      const bool hullContains = Inside(hull, p);
+      inHull += hullContains;
+      for(int v = 0; v < kVolumes; ++v)
+      {
+        const bool contains = bounds.Contains((Volume)v, p);
+        inVolume[v] += contains;
+        escapes += hullContains && !contains; // a bounding volume that misses some of its hull
+      }
+    }
+  }
+  if(escapes)
+    printf("%d hull samples were outside a bounding volume\n\n", escapes);
+
+  const int kObjects = 10000000;
+  std::vector<Object> objects(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    objects[o].m_mesh = &mesh[rand() % kMeshes];
+    objects[o].m_position.x = random(-50.f, 50.f);
+    objects[o].m_position.y = random(-50.f, 50.f);
+    objects[o].m_position.z = random(-50.f, 50.f);
+  }
+
+  std::vector<float3> aabbMin(kObjects);
+  std::vector<float3> aabbMax(kObjects);
+  std::vector<float4> sevenMin(kObjects);
+  std::vector<float4> sevenMax(kObjects);
+  std::vector<AABT> aabtMin(kObjects);
+  std::vector<AABT> aabtMax(kObjects);
+  std::vector<BoundingSphere> sphere(kObjects);
+  for(int a = 0; a < kObjects; ++a)
+  {
+    objects[a].CalculateAABB(&aabbMin[a], &aabbMax[a]);
+    sevenMin[a].a = aabbMin[a].x;
+    sevenMin[a].b = aabbMin[a].y;
+    sevenMin[a].c = aabbMin[a].z;
+    sevenMin[a].d = -(aabbMax[a].x + aabbMax[a].y + aabbMax[a].z);
+    sevenMax[a].a = aabbMax[a].x;
+    sevenMax[a].b = aabbMax[a].y;
+    sevenMax[a].c = aabbMax[a].z;
+    sevenMax[a].d = -(aabbMin[a].x + aabbMin[a].y + aabbMin[a].z);
+    objects[a].CalculateAABT(&aabtMin[a], &aabtMax[a]);
+    CalculateBoundingSphere(objects[a], &sphere[a]);
+  }
+
+  const char *title = "%14s | %6s | %7s | %7s | %6s | %7s | %7s | %7s\n";
+  printf(title, "Bounding", "volume", "accepts", "true", "false", "broad", "narrow", "total");
+  printf(title, "Volume", "/ hull", "", "overlap", "pos.", "seconds", "seconds", "seconds");
+  printf("---------------------------------------------------------------------------------\n");
+  const char *format = "%14s | %6.2f | %7d | %7d | %5.1f%% | %7.4f | %7.4f | %7.4f\n";
+
+  for(int v = 0; v < kVolumes; ++v)
+  {
+    std::vector<Pair> pairs;
+    int accepts;
+    float broadSeconds;
+    switch(v)
+    {
+    case kAABB:
+      broadSeconds = BroadPhase(kTests, kObjects, [&](int test, int t)
+      {
+        return aabbMin[t].x <= aabbMax[test].x && aabbMin[t].y <= aabbMax[test].y && aabbMin[t].z <= aabbMax[test].z
+            && aabbMin[test].x <= aabbMax[t].x && aabbMin[test].y <= aabbMax[t].y && aabbMin[test].z <= aabbMax[t].z;
+      }, &accepts, &pairs);
+      break;
+    case kSevenSided:
+      broadSeconds = BroadPhase(kTests, kObjects, [&](int test, int t)
+      {
+        return sevenMin[t] <= sevenMax[test] && sevenMin[test] <= sevenMax[t];
+      }, &accepts, &pairs);
+      break;
+    case kAABO:
+      broadSeconds = BroadPhase(kTests, kObjects, [&](int test, int t)
+      {
+        return aabtMin[t] <= aabtMax[test] && aabtMin[test] <= aabtMax[t];
+      }, &accepts, &pairs);
+      break;
+    case kTetrahedron:
+      broadSeconds = BroadPhase(kTests, kObjects, [&](int test, int t)
+      {
+        return aabtMin[t] <= aabtMax[test];
+      }, &accepts, &pairs);
+      break;
+    default:
+      broadSeconds = BroadPhase(kTests, kObjects, [&](int test, int t)
+      {
+        const float3 d = {sphere[t].a - sphere[test].a, sphere[t].b - sphere[test].b, sphere[t].c - sphere[test].c};
+        const float r = sphere[t].d + sphere[test].d;
+        return dot(d, d) <= r * r;
+      }, &accepts, &pairs);
+    }
+
+    const Clock narrow;
+    int overlaps = 0;
+    for(int p = 0; p < pairs.size(); ++p)
+      overlaps += Overlap(PointSet(objects[pairs[p].m_probe]), PointSet(objects[pairs[p].m_target]));
+    const float narrowSeconds = narrow.seconds();
+
+    printf(format, kVolumeName[v], inVolume[v] / inHull, accepts, overlaps, 100.f * (accepts - overlaps) / accepts,
+           broadSeconds, narrowSeconds, broadSeconds + narrowSeconds);
+  }
+  return 0;
+}
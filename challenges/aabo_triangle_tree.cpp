@@ -0,0 +1,551 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include <float.h>
+#include <immintrin.h>
+
+struct Clock
+{
+  const clock_t m_start;
+  Clock() : m_start(clock())
+  {
+  }
+  float seconds() const
+  {
+    const clock_t end = clock();
+    const float seconds = ((float)(end - m_start)) / CLOCKS_PER_SEC;
+    return seconds;
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+float3 operator-(const float3 a, const float3 b)
+{
+  float3 c = {a.x-b.x, a.y-b.y, a.z-b.z};
+  return c;
+}
+
+struct Triangle
+{
+  int m_vertex[3];
+};
+
+// A closed surface rather than a point cloud: a sphere of rings and segments, bumpy, in
+// its own frame, for objects to share.
+struct TriMesh
+{
+  std::vector<float3> m_point;
+  std::vector<Triangle> m_triangle;
+
+  void Generate(int rings, int segments, float radius)
+  {
+    const float pi = 3.14159265f;
+    for(int r = 0; r <= rings; ++r)
+      for(int s = 0; s < segments; ++s)
+      {
+        const float theta = pi * r / rings;
+        const float phi = 2.f * pi * s / segments;
+        const float bumpy = radius * random(0.8f, 1.2f);
+        const float3 p = {bumpy * sinf(theta) * cosf(phi), bumpy * sinf(theta) * sinf(phi), bumpy * cosf(theta)};
+        m_point.push_back(p);
+      }
+    for(int r = 0; r < rings; ++r)
+      for(int s = 0; s < segments; ++s)
+      {
+        const int v00 = r * segments + s;
+        const int v01 = r * segments + (s + 1) % segments;
+        const int v10 = v00 + segments;
+        const int v11 = v01 + segments;
+        const Triangle t0 = {{v00, v10, v11}};
+        const Triangle t1 = {{v00, v11, v01}};
+        m_triangle.push_back(t0);
+        m_triangle.push_back(t1);
+      }
+  }
+
+  void CalculateAABT(int triangle, AABT* mini, AABT* maxi) const
+  {
+    const Triangle& t = m_triangle[triangle];
+    *mini = *maxi = xyzToAbcd(m_point[t.m_vertex[0]]);
+    for(int v = 1; v < 3; ++v)
+    {
+      const float4 abcd = xyzToAbcd(m_point[t.m_vertex[v]]);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  }
+};
+
+struct Node
+{
+  AABT m_min;
+  AABT m_max;
+  int m_first; // first child if m_count is 0, otherwise first triangle
+  int m_count;
+};
+
+AABT Offset(const AABT a, const float4 offset)
+{
+  AABT b;
+  b.abcd = _mm_add_ps(a.abcd, offset.abcd);
+  return b;
+}
+
+// A hierarchy over a mesh's triangles, in the mesh's frame, built once and used by every
+// object with that mesh. A mesh is a few thousand triangles, so a median split along the
+// longest of the four centroid axes builds it in no time.
+class TriangleTree
+{
+public:
+  static const int kLeafMax = 4;
+
+  std::vector<Node> m_node;
+  std::vector<int> m_triangle; // triangle indices, in leaf order
+  std::vector<AABT> m_aabtMin; // the triangles' bounds, also in leaf order
+  std::vector<AABT> m_aabtMax;
+
+  TriangleTree(const TriMesh& mesh) : m_triangle(mesh.m_triangle.size()), m_aabtMin(mesh.m_triangle.size()), m_aabtMax(mesh.m_triangle.size())
+  {
+    for(int t = 0; t < m_triangle.size(); ++t)
+    {
+      m_triangle[t] = t;
+      mesh.CalculateAABT(t, &m_aabtMin[t], &m_aabtMax[t]);
+    }
+    std::vector<AABT> byTriangleMin = m_aabtMin, byTriangleMax = m_aabtMax;
+    m_node.push_back(Node());
+    Build(0, 0, m_triangle.size(), byTriangleMin, byTriangleMax);
+    for(int i = 0; i < m_triangle.size(); ++i)
+    {
+      m_aabtMin[i] = byTriangleMin[m_triangle[i]];
+      m_aabtMax[i] = byTriangleMax[m_triangle[i]];
+    }
+  }
+
+  // Appends every triangle whose AABO overlaps the query, which is in the mesh's frame.
+  void Query(const AABT queryMin, const AABT queryMax, std::vector<int>* hits) const
+  {
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while(top)
+    {
+      const Node& node = m_node[stack[--top]];
+      if(!(node.m_min <= queryMax && queryMin <= node.m_max))
+        continue;
+      if(node.m_count)
+      {
+        for(int t = node.m_first; t < node.m_first + node.m_count; ++t)
+        {
+          const AABT targetMin = m_aabtMin[t];
+          if(targetMin <= queryMax)
+          {
+            const AABT targetMax = m_aabtMax[t];
+            if(queryMin <= targetMax)
+              hits->push_back(m_triangle[t]);
+          }
+        }
+      }
+      else
+      {
+        stack[top++] = node.m_first + 1;
+        stack[top++] = node.m_first;
+      }
+    }
+  }
+
+private:
+  void Build(int index, int first, int end, const std::vector<AABT>& aabtMin, const std::vector<AABT>& aabtMax)
+  {
+    AABT mini = aabtMin[m_triangle[first]], maxi = aabtMax[m_triangle[first]];
+    AABT cmin, cmax;
+    cmin.abcd = cmax.abcd = _mm_add_ps(mini.abcd, maxi.abcd);
+    for(int i = first + 1; i < end; ++i)
+    {
+      const int t = m_triangle[i];
+      mini.abcd = _mm_min_ps(mini.abcd, aabtMin[t].abcd);
+      maxi.abcd = _mm_max_ps(maxi.abcd, aabtMax[t].abcd);
+      const __m128 centroid = _mm_add_ps(aabtMin[t].abcd, aabtMax[t].abcd); // doubled, which doesn't change the order
+      cmin.abcd = _mm_min_ps(cmin.abcd, centroid);
+      cmax.abcd = _mm_max_ps(cmax.abcd, centroid);
+    }
+    m_node[index].m_min = mini;
+    m_node[index].m_max = maxi;
+    if(end - first <= kLeafMax)
+    {
+      m_node[index].m_first = first;
+      m_node[index].m_count = end - first;
+      return;
+    }
+
+    const float e[4] = {cmax.a - cmin.a, cmax.b - cmin.b, cmax.c - cmin.c, cmax.d - cmin.d};
+    const int axis = std::max_element(e, e + 4) - e;
+    const int middle = first + (end - first) / 2;
+    std::nth_element(m_triangle.begin() + first, m_triangle.begin() + middle, m_triangle.begin() + end, [&](int a, int b)
+    {
+      float4 ca, cb;
+      ca.abcd = _mm_add_ps(aabtMin[a].abcd, aabtMax[a].abcd);
+      cb.abcd = _mm_add_ps(aabtMin[b].abcd, aabtMax[b].abcd);
+      return ((const float*)&ca)[axis] < ((const float*)&cb)[axis];
+    });
+
+    const int child = m_node.size();
+    m_node[index].m_first = child;
+    m_node[index].m_count = 0;
+    m_node.push_back(Node());
+    m_node.push_back(Node());
+    Build(child, first, middle, aabtMin, aabtMax);
+    Build(child + 1, middle, end, aabtMin, aabtMax);
+  }
+};
+
+// An object with a triangle mesh. Moving the mesh by m_position moves every plane of every
+// AABO in it by dot(m_position, axis), so a query comes into the mesh's frame by taking
+// xyzToAbcd(m_position) off its min and max, and the tree never has to be moved.
+struct TriObject
+{
+  const TriMesh* m_mesh;
+  const TriangleTree* m_tree;
+  float3 m_position;
+
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float4 offset = xyzToAbcd(m_position);
+    *mini = Offset(m_tree->m_node[0].m_min, offset);
+    *maxi = Offset(m_tree->m_node[0].m_max, offset);
+  }
+
+  void Query(const AABT queryMin, const AABT queryMax, std::vector<int>* hits) const
+  {
+    float4 toLocal;
+    toLocal.abcd = _mm_sub_ps(_mm_setzero_ps(), xyzToAbcd(m_position).abcd);
+    m_tree->Query(Offset(queryMin, toLocal), Offset(queryMax, toLocal), hits);
+  }
+};
+
+struct TrianglePair
+{
+  int m_a;
+  int m_b;
+
+  bool operator<(const TrianglePair& p) const
+  {
+    return m_a < p.m_a || (m_a == p.m_a && m_b < p.m_b);
+  }
+
+  bool operator==(const TrianglePair& p) const
+  {
+    return m_a == p.m_a && m_b == p.m_b;
+  }
+};
+
+struct NodePair
+{
+  int m_a;
+  int m_b;
+};
+
+float OctahedronArea(const AABT mini, const AABT maxi)
+{
+  const float e[4] = {maxi.a - mini.a, maxi.b - mini.b, maxi.c - mini.c, maxi.d - mini.d};
+  return e[0]*e[1] + e[0]*e[2] + e[0]*e[3] + e[1]*e[2] + e[1]*e[3] + e[2]*e[3];
+}
+
+// Every pair of triangles, one from each object, whose AABOs overlap. Both trees are
+// descended together as in aabo_dual_tree.cpp, with b's bounds moved into a's frame.
+void Overlaps(const TriObject& a, const TriObject& b, std::vector<TrianglePair>* pairs)
+{
+  const float4 offset = xyzToAbcd(b.m_position - a.m_position);
+  const TriangleTree& ta = *a.m_tree;
+  const TriangleTree& tb = *b.m_tree;
+  NodePair stack[128];
+  int top = 0;
+  stack[top].m_a = stack[top].m_b = 0;
+  ++top;
+  while(top)
+  {
+    const NodePair p = stack[--top];
+    const Node& na = ta.m_node[p.m_a];
+    const Node& nb = tb.m_node[p.m_b];
+    const AABT bMin = Offset(nb.m_min, offset);
+    const AABT bMax = Offset(nb.m_max, offset);
+    if(!(na.m_min <= bMax && bMin <= na.m_max))
+      continue;
+    if(na.m_count && nb.m_count)
+    {
+      for(int i = na.m_first; i < na.m_first + na.m_count; ++i)
+      {
+        const AABT aMin = ta.m_aabtMin[i];
+        const AABT aMax = ta.m_aabtMax[i];
+        for(int j = nb.m_first; j < nb.m_first + nb.m_count; ++j)
+          if(aMin <= Offset(tb.m_aabtMax[j], offset) && Offset(tb.m_aabtMin[j], offset) <= aMax)
+          {
+            const TrianglePair pair = {ta.m_triangle[i], tb.m_triangle[j]};
+            pairs->push_back(pair);
+          }
+      }
+    }
+    else if(nb.m_count || (!na.m_count && OctahedronArea(na.m_min, na.m_max) >= OctahedronArea(nb.m_min, nb.m_max)))
+    {
+      const NodePair left = {na.m_first, p.m_b};
+      const NodePair right = {na.m_first + 1, p.m_b};
+      stack[top++] = right;
+      stack[top++] = left;
+    }
+    else
+    {
+      const NodePair left = {p.m_a, nb.m_first};
+      const NodePair right = {p.m_a, nb.m_first + 1};
+      stack[top++] = right;
+      stack[top++] = left;
+    }
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  const int kMeshes = 4;
+  TriMesh mesh[kMeshes];
+  std::vector<TriangleTree> tree;
+  for(int m = 0; m < kMeshes; ++m)
+  {
+    mesh[m].Generate(16 + 8 * m, 32, random(1.f, 2.f));
+    tree.push_back(TriangleTree(mesh[m]));
+  }
+
+  const int kObjects = 1000;
+  const int kProbes = 1000;
+  std::vector<TriObject> objects(kObjects);
+  std::vector<AABT> aabtMin(kObjects), aabtMax(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    const int m = rand() % kMeshes;
+    objects[o].m_mesh = &mesh[m];
+    objects[o].m_tree = &tree[m];
+    objects[o].m_position.x = random(-25.f, 25.f);
+    objects[o].m_position.y = random(-25.f, 25.f);
+    objects[o].m_position.z = random(-25.f, 25.f);
+    objects[o].CalculateAABT(&aabtMin[o], &aabtMax[o]);
+  }
+
+  // broad phase, the AABO loop of aabo.cpp
+  std::vector<std::pair<int, int> > overlapping;
+  for(int a = 0; a < kObjects; ++a)
+    for(int b = a + 1; b < kObjects; ++b)
+      if(aabtMin[b] <= aabtMax[a] && aabtMin[a] <= aabtMax[b])
+        overlapping.push_back(std::make_pair(a, b));
+  printf("%d pairs of objects overlap, of meshes with %d to %d triangles\n", (int)overlapping.size(), (int)mesh[0].m_triangle.size(), (int)mesh[kMeshes - 1].m_triangle.size());
+
+  // narrow phase, every triangle of one against every triangle of the other, in a's frame
+  std::vector<std::vector<TrianglePair> > expected(overlapping.size());
+  {
+    const Clock clock;
+    int pairs = 0;
+    for(int i = 0; i < overlapping.size(); ++i)
+    {
+      const TriObject& a = objects[overlapping[i].first];
+      const TriObject& b = objects[overlapping[i].second];
+      const float4 offset = xyzToAbcd(b.m_position - a.m_position);
+      for(int ta = 0; ta < a.m_tree->m_triangle.size(); ++ta)
+      {
+        const AABT aMin = a.m_tree->m_aabtMin[ta];
+        const AABT aMax = a.m_tree->m_aabtMax[ta];
+        for(int tb = 0; tb < b.m_tree->m_triangle.size(); ++tb)
+          if(aMin <= Offset(b.m_tree->m_aabtMax[tb], offset) && Offset(b.m_tree->m_aabtMin[tb], offset) <= aMax)
+          {
+            const TrianglePair pair = {a.m_tree->m_triangle[ta], b.m_tree->m_triangle[tb]};
+            expected[i].push_back(pair);
+          }
+      }
+      pairs += expected[i].size();
+    }
+    const float seconds = clock.seconds();
+    printf("Mesh vs mesh, every triangle pair, reported %d triangle pairs in %f seconds\n", pairs, seconds);
+  }
+  {
+    std::vector<std::vector<TrianglePair> > found(overlapping.size());
+    const Clock clock;
+    int pairs = 0;
+    for(int i = 0; i < overlapping.size(); ++i)
+    {
+      Overlaps(objects[overlapping[i].first], objects[overlapping[i].second], &found[i]);
+      pairs += found[i].size();
+    }
+    const float seconds = clock.seconds();
+    int wrong = 0;
+    for(int i = 0; i < overlapping.size(); ++i)
+    {
+      std::sort(found[i].begin(), found[i].end());
+      std::sort(expected[i].begin(), expected[i].end());
+      wrong += found[i] != expected[i];
+    }
+    printf("Mesh vs mesh, triangle trees, reported %d triangle pairs in %f seconds, %d object pairs disagreeing\n", pairs, seconds, wrong);
+  }
+
+  // query vs mesh: small probes, such as projectiles, against the triangles of the objects they hit
+  Mesh probeMesh;
+  probeMesh.Generate(20, 0.25f);
+  std::vector<AABT> probeMin(kProbes), probeMax(kProbes);
+  for(int p = 0; p < kProbes; ++p)
+  {
+    Object probe;
+    probe.m_mesh = &probeMesh;
+    probe.m_position.x = random(-25.f, 25.f);
+    probe.m_position.y = random(-25.f, 25.f);
+    probe.m_position.z = random(-25.f, 25.f);
+    probe.CalculateAABT(&probeMin[p], &probeMax[p]);
+  }
+  std::vector<std::pair<int, int> > probed;
+  for(int p = 0; p < kProbes; ++p)
+    for(int o = 0; o < kObjects; ++o)
+      if(aabtMin[o] <= probeMax[p] && probeMin[p] <= aabtMax[o])
+        probed.push_back(std::make_pair(p, o));
+
+  std::vector<std::vector<int> > hits(probed.size());
+  {
+    const Clock clock;
+    int triangles = 0;
+    for(int i = 0; i < probed.size(); ++i)
+    {
+      const TriObject& o = objects[probed[i].second];
+      float4 toLocal;
+      toLocal.abcd = _mm_sub_ps(_mm_setzero_ps(), xyzToAbcd(o.m_position).abcd);
+      const AABT queryMin = Offset(probeMin[probed[i].first], toLocal);
+      const AABT queryMax = Offset(probeMax[probed[i].first], toLocal);
+      for(int t = 0; t < o.m_tree->m_triangle.size(); ++t)
+        if(o.m_tree->m_aabtMin[t] <= queryMax && queryMin <= o.m_tree->m_aabtMax[t])
+          hits[i].push_back(o.m_tree->m_triangle[t]);
+      triangles += hits[i].size();
+    }
+    const float seconds = clock.seconds();
+    printf("Query vs mesh, every triangle, %d probe-object pairs reported %d triangles in %f seconds\n", (int)probed.size(), triangles, seconds);
+  }
+  {
+    std::vector<std::vector<int> > found(probed.size());
+    const Clock clock;
+    int triangles = 0;
+    for(int i = 0; i < probed.size(); ++i)
+    {
+      objects[probed[i].second].Query(probeMin[probed[i].first], probeMax[probed[i].first], &found[i]);
+      triangles += found[i].size();
+    }
+    const float seconds = clock.seconds();
+    int wrong = 0;
+    for(int i = 0; i < probed.size(); ++i)
+    {
+      std::sort(found[i].begin(), found[i].end());
+      std::sort(hits[i].begin(), hits[i].end());
+      wrong += found[i] != hits[i];
+    }
+    printf("Query vs mesh, triangle trees, reported %d triangles in %f seconds, %d queries disagreeing\n", triangles, seconds, wrong);
+  }
+  return 0;
+}
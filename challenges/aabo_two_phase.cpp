@@ -0,0 +1,266 @@
+#include "stdio.h"
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include <immintrin.h>
+
+struct Clock
+{
+  const clock_t m_start;
+  Clock() : m_start(clock())
+  {
+  }
+  float seconds() const
+  {
+    const clock_t end = clock();
+    const float seconds = ((float)(end - m_start)) / CLOCKS_PER_SEC;
+    return seconds;
+  }
+};
+
+struct float3
+{
+  float x,y,z;
+};
+
+float3 operator+(const float3 a, const float3 b)
+{
+  float3 c = {a.x+b.x, a.y+b.y, a.z+b.z};
+  return c;
+}
+
+float dot(const float3 a, const float3 b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+float length(const float3 a)
+{
+  return sqrtf(dot(a,a));
+}
+
+union float4
+{
+  __m128 abcd;
+  struct { float a,b,c,d; };
+};
+
+bool operator<=(const float4 a, const float4 b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a.abcd,b.abcd)) == 0xF;
+}
+
+float4 min(const float4 a, const float4 b)
+{
+  float4 c = {std::min(a.a,b.a), std::min(a.b,b.b), std::min(a.c,b.c), std::min(a.d,b.d)};
+  return c;
+}
+
+float4 max(const float4 a, const float4 b)
+{
+  float4 c = {std::max(a.a,b.a), std::max(a.b,b.b), std::max(a.c,b.c), std::max(a.d,b.d)};
+  return c;
+}
+
+typedef float4 AABT;
+
+float random(float lo, float hi)
+{
+  const int grain = 10000;
+  const float t = (rand() % grain) * 1.f/(grain-1);
+  return lo + (hi - lo) * t;
+}
+
+struct Mesh
+{
+  std::vector<float3> m_point;
+  void Generate(int points, float radius)
+  {
+    m_point.resize(points);
+    for(int p = 0; p < points; ++p)
+    {
+      do
+      {
+        m_point[p].x = random(-radius, radius);
+        m_point[p].y = random(-radius, radius);
+        m_point[p].z = random(-radius, radius);
+      } while(length(m_point[p]) > radius);
+    }
+  }
+};
+
+const float3 abcdInXyz[4] =
+{
+ {-1,0,-1/sqrtf(2)}, // A
+ {+1,0,-1/sqrtf(2)}, // B
+ {0,-1, 1/sqrtf(2)}, // C
+ {0,+1, 1/sqrtf(2)}, // D
+};
+
+float4 xyzToAbcd(const float3 xyz)
+{
+  float4 abcd;
+  abcd.a = dot(xyz, abcdInXyz[0]);
+  abcd.b = dot(xyz, abcdInXyz[1]);
+  abcd.c = dot(xyz, abcdInXyz[2]);
+  abcd.d = dot(xyz, abcdInXyz[3]);
+  return abcd;
+}
+
+struct Object
+{
+  Mesh *m_mesh;
+  float3 m_position;
+  void CalculateAABT(AABT* mini, AABT* maxi) const
+  {
+    const float3 xyz = m_position + m_mesh->m_point[0];
+    *mini = *maxi = xyzToAbcd(xyz);
+    for(int p = 1; p < m_mesh->m_point.size(); ++p)
+    {
+      const float3 xyz = m_position + m_mesh->m_point[p];
+      const float4 abcd = xyzToAbcd(xyz);
+      *mini = min(*mini, abcd);
+      *maxi = max(*maxi, abcd);
+    }
+  };
+};
+
+const int kChunk = 4096; // objects whose candidates are confirmed before moving on, 64KB of up column
+const int kAhead = 8;    // candidates to prefetch ahead in the down column
+
+// Phase one: streams only the up column and writes the index of every object whose up
+// tetrahedron passes. The write always happens, and the count advances by 0 or 1,
+// so there's no branch to mispredict no matter how the lanes come out.
+int UpPass(const AABT* aabtMin, int first, int end, const AABT probeMax, int* candidate)
+{
+  int n = 0;
+  int t = first;
+#if defined(__AVX512F__) && defined(__BMI2__)
+  // four objects per register and one mask bit per plane. An object passes if all four of its
+  // bits do; pext gathers those into one bit per object, and a compressing store writes the
+  // indices of the passing objects out of sixteen with one instruction.
+  const __m512 query = _mm512_maskz_broadcast_f32x4(0xFFFF, probeMax.abcd);
+  const __m512i lanes = _mm512_setr_epi32(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+  for(; t + 16 <= end; t += 16)
+  {
+    unsigned objects = 0;
+    for(int r = 0; r < 4; ++r)
+    {
+      const unsigned planes = _mm512_cmp_ps_mask(_mm512_loadu_ps((const float*)&aabtMin[t + r * 4]), query, _CMP_LE_OQ);
+      objects |= _pext_u32(planes & (planes >> 1) & (planes >> 2) & (planes >> 3), 0x1111) << (r * 4);
+    }
+    _mm512_mask_compressstoreu_epi32(candidate + n, (__mmask16)objects, _mm512_add_epi32(lanes, _mm512_set1_epi32(t)));
+    n += _mm_popcnt_u32(objects);
+  }
+#endif
+  for(; t < end; ++t)
+  {
+    candidate[n] = t;
+    n += _mm_movemask_ps(_mm_cmple_ps(aabtMin[t].abcd, probeMax.abcd)) == 0xF;
+  }
+  return n;
+}
+
+// Phase two: reads the down column only at the candidates, in ascending order,
+// prefetching a few candidates ahead since their addresses are already known.
+int DownPass(const AABT* aabtMax, const int* candidate, int n, const AABT probeMin)
+{
+  int intersections = 0;
+  for(int c = 0; c < n; ++c)
+  {
+    if(c + kAhead < n)
+      _mm_prefetch((const char*)&aabtMax[candidate[c + kAhead]], _MM_HINT_T0);
+    intersections += probeMin <= aabtMax[candidate[c]];
+  }
+  return intersections;
+}
+
+int main(int argc, char* argv[])
+{
+  Mesh mesh;
+  mesh.Generate(100, 1.0f);
+
+  const int kTests = 100;
+
+  const int kObjects = 10000000;
+  std::vector<Object> objects(kObjects);
+  for(int o = 0; o < kObjects; ++o)
+  {
+    objects[o].m_mesh = &mesh;
+    objects[o].m_position.x = random(-50.f, 50.f);
+    objects[o].m_position.y = random(-50.f, 50.f);
+    objects[o].m_position.z = random(-50.f, 50.f);
+  }
+
+  std::vector<AABT> aabtMin(kObjects);
+  std::vector<AABT> aabtMax(kObjects);
+  for(int a = 0; a < kObjects; ++a)
+    objects[a].CalculateAABT(&aabtMin[a], &aabtMax[a]);
+
+  {
+    const Clock clock;
+    int trivials = 0;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+    {
+      const AABT probeMin = aabtMin[test];
+      const AABT probeMax = aabtMax[test];
+      for(int t = 0; t < kObjects; ++t)
+      {
+        const AABT targetMin = aabtMin[t];
+        if(targetMin <= probeMax)
+        {
+          ++trivials;
+	  const AABT targetMax = aabtMax[t];
+	  if(probeMin <= targetMax)
+	    ++intersections;
+        }
+      }
+    }
+    const float seconds = clock.seconds();
+
+    printf("AABO SIMD reported %d intersections (%d partial accepts) in %f seconds\n", intersections, trivials, seconds);
+  }
+
+  {
+    // both phases over the whole array: by the time a candidate is confirmed,
+    // the up column around it left the cache long ago
+    std::vector<int> candidate(kObjects);
+    const Clock clock;
+    int trivials = 0;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+    {
+      const int n = UpPass(aabtMin.data(), 0, kObjects, aabtMax[test], candidate.data());
+      trivials += n;
+      intersections += DownPass(aabtMax.data(), candidate.data(), n, aabtMin[test]);
+    }
+    const float seconds = clock.seconds();
+
+    printf("AABO two-phase, whole array, reported %d intersections (%d partial accepts) in %f seconds\n", intersections, trivials, seconds);
+  }
+
+  {
+    std::vector<int> candidate(kChunk);
+    const Clock clock;
+    int trivials = 0;
+    int intersections = 0;
+    for(int test = 0; test < kTests; ++test)
+    {
+      const AABT probeMin = aabtMin[test];
+      const AABT probeMax = aabtMax[test];
+      for(int first = 0; first < kObjects; first += kChunk)
+      {
+        const int n = UpPass(aabtMin.data(), first, std::min(first + kChunk, kObjects), probeMax, candidate.data());
+        trivials += n;
+        intersections += DownPass(aabtMax.data(), candidate.data(), n, probeMin);
+      }
+    }
+    const float seconds = clock.seconds();
+
+    printf("AABO two-phase, %d object chunks, reported %d intersections (%d partial accepts) in %f seconds\n", kChunk, intersections, trivials, seconds);
+  }
+  return 0;
+}